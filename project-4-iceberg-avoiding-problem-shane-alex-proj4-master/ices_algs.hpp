@@ -13,8 +13,10 @@
 #pragma once
 
 #include <cassert>
+#include <cmath>
 #include <iostream>
 
+#include "ices_parallel.hpp"
 #include "ices_types.hpp"
 
 namespace ices {
@@ -71,6 +73,117 @@ unsigned int iceberg_avoiding_exhaustive(const grid& setting) {
   return count_paths;
 }
 
+// Count the paths from (row, column) to the bottom-right corner by depth
+// first search, abandoning a branch as soon as it would leave the grid or
+// step onto an iceberg. (row, column) must itself be passable.
+unsigned int count_paths_from(const grid& setting, coordinate row, coordinate column) {
+  if ((row == setting.rows() - 1) && (column == setting.columns() - 1)) {
+    return 1;
+  }
+  unsigned int count = 0;
+  if (setting.may_step(row, column + 1)) {
+    count += count_paths_from(setting, row, column + 1);
+  }
+  if (setting.may_step(row + 1, column)) {
+    count += count_paths_from(setting, row + 1, column);
+  }
+  return count;
+}
+
+// Solve the iceberg avoiding problem for the given grid, using a parallel
+// exhaustive search.
+//
+// Every path prefix of prefix_steps steps is enumerated as a bitmask, in the
+// same bit order as iceberg_avoiding_exhaustive, and each prefix that stays
+// on water becomes one depth first search task on the pool. Every worker
+// keeps its own count and the counts are summed at the end, so the result
+// does not depend on scheduling.
+//
+// prefix_steps of 0 picks enough prefixes to keep every worker busy. It is
+// clamped to the path length.
+//
+// The grid must be non-empty.
+unsigned int iceberg_avoiding_exhaustive_parallel(const grid& setting,
+                                                  size_t prefix_steps = 0,
+                                                  work_stealing_pool& pool = default_pool()) {
+
+  // grid must be non-empty.
+  assert(setting.rows() > 0);
+  assert(setting.columns() > 0);
+
+  // Compute the path length, and check that it is legal.
+  const size_t steps = setting.rows() + setting.columns() - 2;
+  assert(steps < 64);
+
+  if (prefix_steps == 0) {
+    // About 16 tasks per worker, so stealing can even out unlucky prefixes.
+    while ((size_t(1) << prefix_steps) < 16 * size_t(pool.size())) {
+      ++prefix_steps;
+    }
+  }
+  prefix_steps = std::min(prefix_steps, steps);
+
+  std::vector<unsigned int> worker_counts(pool.size(), 0);
+  pool.parallel_for(size_t(1) << prefix_steps, [&](size_t bits, unsigned worker) {
+    coordinate row = 0, column = 0;
+    for (size_t k = 0; k < prefix_steps; ++k) {
+      if ((bits >> k) & 1) {
+        ++column;
+      } else {
+        ++row;
+      }
+      if (!setting.may_step(row, column)) {
+        return;
+      }
+    }
+    worker_counts[worker] += count_paths_from(setting, row, column);
+  });
+
+  unsigned int count_paths = 0;
+  for (auto count : worker_counts) {
+    count_paths += count;
+  }
+  return count_paths;
+}
+
+// Advance columns [first, end) of a rolling row of path counts by one grid
+// row, given the count entering column first from the left. Returns the
+// count leaving column end-1 to the right.
+unsigned int advance_count_range(const grid_word* icebergs, unsigned int* counts,
+                                 coordinate first, coordinate end,
+                                 unsigned int from_left = 0) {
+  for (coordinate base = first; base < end; ) {
+    grid_word word = icebergs[base / GRID_WORD_BITS] >> (base % GRID_WORD_BITS);
+    coordinate stop = std::min(end, (base / GRID_WORD_BITS + 1) * GRID_WORD_BITS);
+    if (word == 0) {
+      // No icebergs in these cells: a plain running sum.
+      for (coordinate c = base; c < stop; ++c) {
+        from_left += counts[c];
+        counts[c] = from_left;
+      }
+    } else {
+      for (coordinate c = base; c < stop; ++c) {
+        unsigned int water = unsigned(((word >> (c - base)) & 1) ^ 1);
+        from_left = (counts[c] + from_left) & (0u - water);
+        counts[c] = from_left;
+      }
+    }
+    base = stop;
+  }
+  return from_left;
+}
+
+// Advance a rolling row of path counts by one grid row.
+//
+// On entry counts[c] holds the number of paths reaching column c of the
+// previous row; on exit it holds the counts for the row whose bit-packed
+// icebergs are given. Before the first row, counts should be 1 in column 0
+// and 0 elsewhere, as if a path entered (0, 0) from above.
+void advance_count_row(const grid_word* icebergs, unsigned int* counts,
+                       coordinate columns) {
+  advance_count_range(icebergs, counts, 0, columns);
+}
+
 // Solve the iceberg avoiding problem for the given grid, using a dynamic
 // programming algorithm.
 //
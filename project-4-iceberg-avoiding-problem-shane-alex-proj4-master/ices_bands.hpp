@@ -0,0 +1,286 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_bands.hpp
+//
+// Path counting that jumps over bands of iceberg-free rows.
+//
+// Across one row with no icebergs the rolling DP replaces the count row by
+// its prefix sums. After h such rows, column c holds
+//
+//   sum over c' <= c of C(h - 1 + (c - c'), c - c') * counts[c'],
+//
+// the convolution of the count row with a kernel of binomial coefficients.
+// So a band of h empty rows can be crossed with one convolution instead of
+// h row updates, and the DP only has to visit rows with icebergs.
+//
+// Counts are modulo 2^32, which has no roots of unity for a number
+// theoretic transform. The convolution is instead computed exactly, modulo
+// three NTT-friendly primes whose product exceeds every possible sum, and
+// the residues are combined with the Chinese remainder theorem. Short rows
+// use a direct convolution, and short bands the ordinary DP, whichever is
+// cheapest.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "ices_algs.hpp"
+#include "ices_parallel.hpp"
+#include "ices_sparse.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// a^e modulo m.
+constexpr std::uint32_t power_mod(std::uint64_t a, std::uint64_t e, std::uint32_t m) {
+  std::uint64_t result = 1;
+  a %= m;
+  for (; e > 0; e >>= 1, a = a * a % m) {
+    if (e & 1) {
+      result = result * a % m;
+    }
+  }
+  return std::uint32_t(result);
+}
+
+// The three primes, each of the form k * 2^j + 1 with 3 a primitive root.
+// Their product is just over 2^86, enough for the exact convolution of
+// 2^22 pairs of 32-bit counts.
+const std::uint32_t NTT_PRIME_1 = 998244353, NTT_PRIME_2 = 167772161, NTT_PRIME_3 = 469762049;
+const std::uint32_t NTT_ROOT = 3;
+
+// Longest row a band can be convolved over with the NTT.
+const coordinate BAND_NTT_MAX_COLUMNS = coordinate(1) << 22;
+
+// In-place number theoretic transform modulo MOD of a power-of-two length
+// vector; the inverse transform includes the division by the length. The
+// modulus is a template parameter so that the compiler can replace the
+// divisions by multiplications.
+template <std::uint32_t MOD>
+void ntt(std::vector<std::uint32_t>& a, bool invert) {
+  const size_t n = a.size();
+  assert((n & (n - 1)) == 0);
+  for (size_t i = 1, j = 0; i < n; ++i) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      std::swap(a[i], a[j]);
+    }
+  }
+  std::vector<std::uint32_t> twiddles(n / 2);
+  for (size_t length = 2; length <= n; length <<= 1) {
+    std::uint32_t step = power_mod(NTT_ROOT, (MOD - 1) / length, MOD);
+    if (invert) {
+      step = power_mod(step, MOD - 2, MOD);
+    }
+    const size_t half = length / 2;
+    twiddles[0] = 1;
+    for (size_t k = 1; k < half; ++k) {
+      twiddles[k] = std::uint32_t(std::uint64_t(twiddles[k - 1]) * step % MOD);
+    }
+    for (size_t i = 0; i < n; i += length) {
+      for (size_t k = 0; k < half; ++k) {
+        std::uint32_t u = a[i + k],
+                      v = std::uint32_t(std::uint64_t(a[i + k + half]) * twiddles[k] % MOD);
+        a[i + k] = (u + v >= MOD) ? u + v - MOD : u + v;
+        a[i + k + half] = (u >= v) ? u - v : u + MOD - v;
+      }
+    }
+  }
+  if (invert) {
+    const std::uint64_t scale = power_mod(n, MOD - 2, MOD);
+    for (auto& x : a) {
+      x = std::uint32_t(x * scale % MOD);
+    }
+  }
+}
+
+// The first width terms of the convolution of values and kernel, modulo
+// MOD, through transforms of length padded.
+template <std::uint32_t MOD>
+std::vector<std::uint32_t> convolve_mod(const unsigned int* values, const unsigned int* kernel,
+                                        coordinate width, size_t padded) {
+  std::vector<std::uint32_t> a(padded, 0), b(padded, 0);
+  for (coordinate c = 0; c < width; ++c) {
+    a[c] = values[c] % MOD;
+    b[c] = kernel[c] % MOD;
+  }
+  ntt<MOD>(a, false);
+  ntt<MOD>(b, false);
+  for (size_t i = 0; i < padded; ++i) {
+    a[i] = std::uint32_t(std::uint64_t(a[i]) * b[i] % MOD);
+  }
+  ntt<MOD>(a, true);
+  a.resize(width);
+  return a;
+}
+
+// Replace counts[0 .. width) by its convolution with kernel, truncated to
+// width terms, modulo 2^32, using the NTT. The three primes are
+// independent, so they run in parallel.
+void convolve_ntt(unsigned int* counts, const unsigned int* kernel, coordinate width,
+                  work_stealing_pool& pool = default_pool()) {
+  assert(width <= BAND_NTT_MAX_COLUMNS);
+  size_t padded = 1;
+  while (padded < 2 * size_t(width)) {
+    padded <<= 1;
+  }
+  std::vector<std::uint32_t> residues[3];
+  pool.parallel_for(3, [&](size_t prime, unsigned) {
+    switch (prime) {
+    case 0: residues[0] = convolve_mod<NTT_PRIME_1>(counts, kernel, width, padded); break;
+    case 1: residues[1] = convolve_mod<NTT_PRIME_2>(counts, kernel, width, padded); break;
+    case 2: residues[2] = convolve_mod<NTT_PRIME_3>(counts, kernel, width, padded); break;
+    }
+  });
+
+  // Garner's algorithm: x = r1 + p1 * t2 + p1 * p2 * t3 with each digit
+  // below its prime, so the last step can be done modulo 2^32.
+  constexpr std::uint64_t p1 = NTT_PRIME_1, p2 = NTT_PRIME_2, p3 = NTT_PRIME_3;
+  constexpr std::uint64_t inverse_p1_mod_p2 = power_mod(p1, p2 - 2, p2),
+                          inverse_p1p2_mod_p3 = power_mod(p1 * p2 % p3, p3 - 2, p3);
+  for (coordinate c = 0; c < width; ++c) {
+    std::uint64_t r1 = residues[0][c], r2 = residues[1][c], r3 = residues[2][c];
+    std::uint64_t t2 = (r2 + p2 - r1 % p2) % p2 * inverse_p1_mod_p2 % p2;
+    std::uint64_t partial = (r1 + p1 % p3 * t2) % p3;
+    std::uint64_t t3 = (r3 + p3 - partial) % p3 * inverse_p1p2_mod_p3 % p3;
+    counts[c] = unsigned(r1 + std::uint32_t(p1) * unsigned(t2) +
+                         unsigned(p1 * p2) * unsigned(t3));
+  }
+}
+
+// Replace counts[0 .. width) by its convolution with kernel, truncated to
+// width terms, modulo 2^32, directly in O(width^2) time.
+void convolve_direct(unsigned int* counts, const unsigned int* kernel, coordinate width) {
+  // Working from the right leaves counts[0 .. c] untouched when column c
+  // is computed.
+  for (coordinate c = width; c-- > 0; ) {
+    unsigned int sum = 0;
+    for (coordinate d = 0; d <= c; ++d) {
+      sum += kernel[d] * counts[c - d];
+    }
+    counts[c] = sum;
+  }
+}
+
+// The kernel for a band of height iceberg-free rows: C(height - 1 + d, d)
+// for d in [0, width).
+std::vector<unsigned int> band_kernel(const binomial_table& binomial, coordinate height,
+                                      coordinate width) {
+  assert(height > 0);
+  std::vector<unsigned int> kernel(width);
+  for (coordinate d = 0; d < width; ++d) {
+    kernel[d] = binomial(height - 1 + d, d);
+  }
+  return kernel;
+}
+
+// How a band of empty rows was crossed.
+enum band_method { BAND_AUTO, BAND_ROWS, BAND_DIRECT, BAND_NTT };
+
+// Rough costs, in row-DP cell updates, of one multiply-add of the direct
+// convolution and of one butterfly of each NTT.
+const double BAND_DIRECT_COST = 1.0;
+const double BAND_NTT_COST = 12.0;
+
+// The cheapest way to cross a band of height empty rows, width columns
+// wide.
+band_method choose_band_method(coordinate height, coordinate width) {
+  const double rows_cost = double(height) * double(width),
+               direct_cost = BAND_DIRECT_COST * double(width) * double(width + 1) / 2;
+  double padded = 1;
+  unsigned levels = 0;
+  while (padded < 2 * double(width)) {
+    padded *= 2;
+    ++levels;
+  }
+  // Three primes, three transforms each.
+  const double ntt_cost = BAND_NTT_COST * 9 * padded / 2 * levels;
+  if (rows_cost <= direct_cost && rows_cost <= ntt_cost) {
+    return BAND_ROWS;
+  }
+  if (direct_cost <= ntt_cost || width > BAND_NTT_MAX_COLUMNS) {
+    return BAND_DIRECT;
+  }
+  return BAND_NTT;
+}
+
+// What iceberg_avoiding_bands did.
+struct band_stats {
+  coordinate bands = 0;          // bands of empty rows crossed by convolution
+  coordinate rows_skipped = 0;   // rows in those bands
+  coordinate ntt_bands = 0;      // of those bands, how many used the NTT
+};
+
+// True if a row has no icebergs.
+inline bool row_is_empty(const grid& setting, coordinate row) {
+  const grid_word* words = setting.row_words(row);
+  const coordinate count = words_per_row(setting.columns());
+  for (coordinate w = 0; w < count; ++w) {
+    if (words[w] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Solve the iceberg avoiding problem with the rolling DP on rows that
+// contain icebergs, crossing each band of empty rows with a single
+// convolution. method forces how bands are crossed; BAND_AUTO picks the
+// cheapest for each band.
+//
+// The grid must be non-empty.
+unsigned int iceberg_avoiding_bands(const grid& setting,
+                                    work_stealing_pool& pool = default_pool(),
+                                    band_method method = BAND_AUTO,
+                                    band_stats* stats = nullptr) {
+
+  // grid must be non-empty.
+  assert(setting.rows() > 0);
+  assert(setting.columns() > 0);
+
+  const coordinate rows = setting.rows(), columns = setting.columns();
+  binomial_table binomial(rows + columns);
+  band_stats local;
+  std::vector<unsigned int> counts(columns, 0);
+  counts[0] = 1;
+  for (coordinate r = 0; r < rows; ) {
+    coordinate end = r;
+    while (end < rows && row_is_empty(setting, end)) {
+      ++end;
+    }
+    const coordinate height = end - r;
+    band_method how = (method == BAND_AUTO) ? choose_band_method(height, columns) : method;
+    if (how == BAND_NTT && columns > BAND_NTT_MAX_COLUMNS) {
+      how = BAND_DIRECT;
+    }
+    if (height == 0 || how == BAND_ROWS) {
+      // A row with icebergs, or a band too short to be worth a convolution.
+      for (coordinate k = 0; k < std::max<coordinate>(height, 1); ++k, ++r) {
+        advance_count_row(setting.row_words(r), counts.data(), columns);
+      }
+      continue;
+    }
+    auto kernel = band_kernel(binomial, height, columns);
+    if (how == BAND_NTT) {
+      convolve_ntt(counts.data(), kernel.data(), columns, pool);
+      ++local.ntt_bands;
+    } else {
+      convolve_direct(counts.data(), kernel.data(), columns);
+    }
+    ++local.bands;
+    local.rows_skipped += height;
+    r = end;
+  }
+  if (stats) {
+    *stats = local;
+  }
+  return counts.back();
+}
+
+}
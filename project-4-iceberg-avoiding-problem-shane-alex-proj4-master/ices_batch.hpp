@@ -0,0 +1,140 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_batch.hpp
+//
+// Solving many independent grids at once.
+//
+// Grids are spread across a work-stealing pool. Each worker keeps one
+// rolling row of counts and reuses it for every grid it solves, so a batch
+// allocates only a handful of rows in total.
+//
+// Grids at most GRID_WORD_BITS columns wide are solved BATCH_LANES at a
+// time: their count rows are interleaved, with entry c of grid l at
+// counts[c * BATCH_LANES + l], so one pass over a row advances every grid
+// of the group with the same vector instructions. Each grid reads its own
+// row of icebergs, columns past its width count as icebergs, and its
+// result is taken as soon as its last row is done. Grids are sorted by
+// size first so the grids of a group are about the same shape.
+//
+// Counts are modulo 2^32, like iceberg_avoiding_dyn_prog.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "ices_algs.hpp"
+#include "ices_io.hpp"
+#include "ices_parallel.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// Number of grids solved together in interleaved lanes.
+const size_t BATCH_LANES = 8;
+
+// Solve up to BATCH_LANES grids, each at most GRID_WORD_BITS columns wide,
+// together, storing their counts in results.
+void solve_lanes(const grid* const* settings, size_t count, unsigned int* results) {
+  assert(count <= BATCH_LANES);
+
+  coordinate width = 0, height = 0;
+  for (size_t l = 0; l < count; ++l) {
+    assert(settings[l]->columns() <= GRID_WORD_BITS);
+    width = std::max(width, settings[l]->columns());
+    height = std::max(height, settings[l]->rows());
+  }
+
+  std::uint32_t counts[GRID_WORD_BITS * BATCH_LANES] = {};
+  for (size_t l = 0; l < BATCH_LANES; ++l) {
+    counts[l] = 1;
+  }
+  for (coordinate r = 0; r < height; ++r) {
+    // Bit c of water[l] is set when cell (r, c) of grid l is water. Unused
+    // lanes and grids that are already done see only icebergs.
+    grid_word water[BATCH_LANES] = {};
+    for (size_t l = 0; l < count; ++l) {
+      const grid& setting = *settings[l];
+      if (r < setting.rows()) {
+        grid_word inside = (setting.columns() == GRID_WORD_BITS)
+                           ? ~grid_word(0) : ((grid_word(1) << setting.columns()) - 1);
+        water[l] = ~setting.row_words(r)[0] & inside;
+      }
+    }
+    std::uint32_t from_left[BATCH_LANES] = {};
+    for (coordinate c = 0; c < width; ++c) {
+      std::uint32_t* lanes = counts + c * BATCH_LANES;
+      for (size_t l = 0; l < BATCH_LANES; ++l) {
+        std::uint32_t mask = 0u - std::uint32_t((water[l] >> c) & 1);
+        from_left[l] = (from_left[l] + lanes[l]) & mask;
+        lanes[l] = from_left[l];
+      }
+    }
+    for (size_t l = 0; l < count; ++l) {
+      if (r + 1 == settings[l]->rows()) {
+        results[l] = counts[(settings[l]->columns() - 1) * BATCH_LANES + l];
+      }
+    }
+  }
+}
+
+// Solve the iceberg avoiding problem for every grid in a batch, spread
+// across the pool. Returns the counts in the same order as the grids. Every
+// grid must be non-empty.
+std::vector<unsigned int> iceberg_avoiding_batch(const std::vector<grid>& settings,
+                                                 work_stealing_pool& pool = default_pool()) {
+  std::vector<unsigned int> results(settings.size(), 0);
+
+  // Narrow grids go into lane groups, ordered by size; the rest are solved
+  // one at a time.
+  std::vector<size_t> narrow, wide;
+  for (size_t i = 0; i < settings.size(); ++i) {
+    assert(settings[i].rows() > 0);
+    assert(settings[i].columns() > 0);
+    (settings[i].columns() <= GRID_WORD_BITS ? narrow : wide).push_back(i);
+  }
+  std::sort(narrow.begin(), narrow.end(), [&](size_t a, size_t b) {
+    if (settings[a].rows() != settings[b].rows()) {
+      return settings[a].rows() < settings[b].rows();
+    }
+    return settings[a].columns() < settings[b].columns();
+  });
+  const size_t groups = (narrow.size() + BATCH_LANES - 1) / BATCH_LANES;
+
+  std::vector<std::vector<unsigned int>> scratch(pool.size());
+  pool.parallel_for(groups + wide.size(), [&](size_t task, unsigned worker) {
+    if (task < groups) {
+      size_t first = task * BATCH_LANES,
+             count = std::min(BATCH_LANES, narrow.size() - first);
+      const grid* group[BATCH_LANES];
+      unsigned int group_results[BATCH_LANES];
+      for (size_t l = 0; l < count; ++l) {
+        group[l] = &settings[narrow[first + l]];
+      }
+      solve_lanes(group, count, group_results);
+      for (size_t l = 0; l < count; ++l) {
+        results[narrow[first + l]] = group_results[l];
+      }
+      return;
+    }
+    const grid& setting = settings[wide[task - groups]];
+    auto& counts = scratch[worker];
+    counts.assign(setting.columns(), 0);
+    counts[0] = 1;
+    for (coordinate r = 0; r < setting.rows(); ++r) {
+      advance_count_row(setting.row_words(r), counts.data(), setting.columns());
+    }
+    results[wide[task - groups]] = counts.back();
+  });
+  return results;
+}
+
+// Solve every grid of a batch file written by write_grid_batch. The file is
+// mapped, not copied.
+std::vector<unsigned int> iceberg_avoiding_batch(const std::string& filename,
+                                                 work_stealing_pool& pool = default_pool()) {
+  return iceberg_avoiding_batch(map_grid_batch(filename), pool);
+}
+
+}
@@ -0,0 +1,40 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_convert.cpp
+//
+// Convert a grid file between the text, binary and run-length formats
+// described in ices_io.hpp.
+//
+// Usage: ices_convert INPUT OUTPUT
+//
+// The input format is detected from its contents; the output format is
+// chosen by the output file's extension (".txt", ".rle", anything else is
+// binary). Rows are converted one at a time, so grids larger than memory
+// can be converted.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <stdexcept>
+
+#include "ices_io.hpp"
+
+int main(int argc, char* argv[]) {
+
+  if (argc != 3) {
+    std::cerr << "usage: " << argv[0] << " INPUT OUTPUT" << std::endl;
+    return 2;
+  }
+
+  try {
+    auto reader = ices::open_row_reader(argv[1]);
+    auto writer = ices::open_row_writer(argv[2], reader->columns());
+    auto rows = ices::copy_rows(*reader, *writer);
+    std::cout << argv[1] << " -> " << argv[2] << ": "
+              << rows << " rows, " << reader->columns() << " columns" << std::endl;
+  } catch (const std::exception& e) {
+    std::cerr << argv[0] << ": " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
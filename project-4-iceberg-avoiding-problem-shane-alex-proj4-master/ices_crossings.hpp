@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_crossings.hpp
+//
+// Counting paths that may pass through a limited number of icebergs.
+//
+// A path may now step on CELL_ICEBERG cells, and we count the paths that
+// cross at most k of them. The DP keeps k + 1 layers per cell: layer j is
+// the number of paths reaching the cell after crossing exactly j icebergs.
+// A water cell adds the layers from above and from the left as usual; an
+// iceberg does the same and then shifts every layer up by one, dropping
+// paths that would cross more than k.
+//
+// The layers of each column are stored next to each other, so one cell's
+// update is a short loop over layers that the compiler turns into vector
+// instructions. With k = 0 this is iceberg_avoiding_dyn_prog. Counts are
+// modulo 2^32.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ices_parallel.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// Advance layered counts by one grid row, over columns [first, first +
+// width).
+//
+// counts holds width * layers entries, layer j of column first + c at
+// counts[c * layers + j]. On entry it holds the row above and on exit this
+// row. from_left holds the layers of column first - 1 of this row, and on
+// exit those of the last column.
+void advance_crossing_row(const grid_word* icebergs, coordinate first, coordinate width,
+                          coordinate layers, unsigned int* __restrict counts,
+                          unsigned int* __restrict from_left) {
+  for (coordinate c = 0; c < width; ++c) {
+    unsigned int* __restrict cell = counts + c * layers;
+    coordinate column = first + c;
+    if ((icebergs[column / GRID_WORD_BITS] >> (column % GRID_WORD_BITS)) & 1) {
+      // Layer j comes from layer j - 1; from_left doubles as the sum.
+      for (coordinate j = layers; j-- > 1; ) {
+        from_left[j] = cell[j - 1] + from_left[j - 1];
+      }
+      from_left[0] = 0;
+    } else {
+      for (coordinate j = 0; j < layers; ++j) {
+        from_left[j] += cell[j];
+      }
+    }
+    for (coordinate j = 0; j < layers; ++j) {
+      cell[j] = from_left[j];
+    }
+  }
+}
+
+// Sum the layers of one cell: the paths that crossed at most k icebergs.
+inline unsigned int sum_layers(const unsigned int* cell, coordinate layers) {
+  unsigned int total = 0;
+  for (coordinate j = 0; j < layers; ++j) {
+    total += cell[j];
+  }
+  return total;
+}
+
+// Count the paths from (0, 0) to the bottom-right corner that step on at
+// most k icebergs, modulo 2^32. Uses (k + 1) * columns counters.
+unsigned int count_paths_crossing(const grid& setting, coordinate k) {
+  const coordinate rows = setting.rows(), columns = setting.columns(), layers = k + 1;
+  std::vector<unsigned int> counts(columns * layers, 0), from_left(layers);
+  // A virtual row above the grid that enters (0, 0) once. (0, 0) may be an
+  // iceberg here; it then counts as a crossing.
+  counts[0] = 1;
+  for (coordinate r = 0; r < rows; ++r) {
+    std::fill(from_left.begin(), from_left.end(), 0);
+    advance_crossing_row(setting.row_words(r), 0, columns, layers, counts.data(),
+                         from_left.data());
+  }
+  return sum_layers(&counts[(columns - 1) * layers], layers);
+}
+
+// count_paths_crossing, solved in tile x tile tiles spread across the pool
+// as a wavefront. Tiles pass their last row of layers down and their last
+// column right through rolling buffers, as in count_move_paths_wavefront.
+unsigned int count_paths_crossing_wavefront(const grid& setting, coordinate k,
+                                            work_stealing_pool& pool = default_pool(),
+                                            coordinate tile = 256) {
+  assert(tile > 0);
+  const coordinate rows = setting.rows(), columns = setting.columns(), layers = k + 1,
+                   bands = (rows + tile - 1) / tile, stripes = (columns + tile - 1) / tile;
+  std::vector<unsigned int> bottom[3], side(rows * layers, 0);
+  for (auto& buffer : bottom) {
+    buffer.resize(columns * layers);
+  }
+  std::vector<std::vector<unsigned int>> scratch(pool.size());
+
+  parallel_wavefront(pool, bands, stripes, [&](coordinate i, coordinate j, unsigned worker) {
+    const coordinate r0 = i * tile, r1 = std::min(rows, r0 + tile),
+                     c0 = j * tile, c1 = std::min(columns, c0 + tile);
+    auto& counts = scratch[worker];
+    if (i > 0) {
+      const auto& above = bottom[(i - 1) % 3];
+      counts.assign(above.begin() + c0 * layers, above.begin() + c1 * layers);
+    } else {
+      counts.assign((c1 - c0) * layers, 0);
+      if (j == 0) {
+        counts[0] = 1;
+      }
+    }
+    for (coordinate r = r0; r < r1; ++r) {
+      unsigned int* from_left = &side[r * layers];
+      if (j == 0) {
+        std::fill(from_left, from_left + layers, 0);
+      }
+      advance_crossing_row(setting.row_words(r), c0, c1 - c0, layers, counts.data(), from_left);
+    }
+    std::copy(counts.begin(), counts.end(), &bottom[i % 3][c0 * layers]);
+  });
+  return sum_layers(&bottom[(bands - 1) % 3][(columns - 1) * layers], layers);
+}
+
+}
@@ -0,0 +1,376 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_disjoint.hpp
+//
+// Counting tuples of vertex-disjoint paths, for convoys of ships.
+//
+// Given k sources and k sinks, the Lindström-Gessel-Viennot lemma says
+// that the determinant of the k x k matrix M, where M[i][j] is the number
+// of paths from source i to sink j, is
+//
+//   sum over permutations s of  sign(s) * (number of k-tuples of pairwise
+//                                          vertex-disjoint paths, the i-th
+//                                          from source i to sink s(i)).
+//
+// Paths move only RIGHT and DOWN, so the grid is a planar acyclic graph.
+// When the sources and the sinks are both ordered from top-right to
+// bottom-left (for example, sources left to right along the top row and
+// sinks left to right along the bottom row), disjoint paths cannot cross,
+// only the identity permutation has any disjoint tuples, and the
+// determinant is exactly the number of convoys.
+//
+// Each row of M is one rolling DP from its source. The DPs run CRT_LANES
+// at a time in interleaved lanes, as in ices_exact.hpp. For a determinant
+// modulo a prime the lanes are different sources; for the exact
+// determinant they are different primes for the same source, the entries
+// are rebuilt by the Chinese remainder theorem, and the determinant is
+// taken by fraction-free Bareiss elimination over big integers.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "ices_exact.hpp"
+#include "ices_parallel.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// One end of a convoy path.
+struct grid_cell {
+  coordinate row, column;
+};
+
+// The largest prime below 2^31, the default modulus.
+const std::uint32_t LGV_PRIME = 2147483647;
+
+// Run the rolling DP in CRT_LANES lanes at once, lane l counting paths from
+// sources[l] modulo modulus[l], and record the count in every lane at each
+// sink: out[s * CRT_LANES + l] for sink s. A lane whose source is at or
+// past setting.rows() is unused and counts nothing. counts is scratch
+// space for columns * CRT_LANES entries.
+ICES_LANE_CLONES
+void count_lanes_to_sinks(const grid& setting, const grid_cell* sources,
+                          const std::uint32_t* modulus, const std::vector<grid_cell>& sinks,
+                          std::uint32_t* __restrict counts, std::uint32_t* out) {
+  std::fill(out, out + sinks.size() * CRT_LANES, 0);
+  coordinate first_row = setting.rows(), first = setting.columns(), last_row = 0, end = 0;
+  for (size_t l = 0; l < CRT_LANES; ++l) {
+    if (sources[l].row < setting.rows()) {
+      first_row = std::min(first_row, sources[l].row);
+      first = std::min(first, sources[l].column);
+    }
+  }
+  for (const grid_cell& sink : sinks) {
+    last_row = std::max(last_row, sink.row);
+    end = std::max(end, sink.column + 1);
+  }
+  if (first_row > last_row || first >= end) {
+    return;
+  }
+
+  // Sinks in row order, so each row only looks at its own.
+  std::vector<size_t> by_row(sinks.size());
+  for (size_t s = 0; s < sinks.size(); ++s) {
+    by_row[s] = s;
+  }
+  std::sort(by_row.begin(), by_row.end(),
+            [&](size_t a, size_t b) { return sinks[a].row < sinks[b].row; });
+  size_t next_sink = 0;
+  while (next_sink < by_row.size() && sinks[by_row[next_sink]].row < first_row) {
+    ++next_sink;
+  }
+
+  std::fill(counts, counts + (end - first) * CRT_LANES, 0);
+  std::uint32_t primes[CRT_LANES];
+  std::copy(modulus, modulus + CRT_LANES, primes);
+  for (coordinate r = first_row; r <= last_row; ++r) {
+    // A lane is zero until its source row, so its source can be seeded as
+    // a single path arriving from above.
+    for (size_t l = 0; l < CRT_LANES; ++l) {
+      if (sources[l].row == r && sources[l].column < end) {
+        counts[(sources[l].column - first) * CRT_LANES + l] = 1;
+      }
+    }
+    const grid_word* icebergs = setting.row_words(r);
+    std::uint32_t from_left[CRT_LANES] = {};
+    for (coordinate c = first; c < end; ++c) {
+      const std::uint32_t mask =
+          0u - std::uint32_t(((icebergs[c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS)) & 1) ^ 1);
+      std::uint32_t* lanes = counts + (c - first) * CRT_LANES;
+      for (size_t l = 0; l < CRT_LANES; ++l) {
+        std::uint32_t sum = from_left[l] + lanes[l];
+        sum = std::min(sum, sum - primes[l]);
+        from_left[l] = sum & mask;
+        lanes[l] = from_left[l];
+      }
+    }
+    for (; next_sink < by_row.size() && sinks[by_row[next_sink]].row == r; ++next_sink) {
+      const grid_cell& sink = sinks[by_row[next_sink]];
+      if (sink.column >= first) {
+        std::copy(counts + (sink.column - first) * CRT_LANES,
+                  counts + (sink.column - first + 1) * CRT_LANES,
+                  out + by_row[next_sink] * CRT_LANES);
+      }
+    }
+  }
+}
+
+// The matrix of path counts from each source to each sink modulo prime,
+// row-major: entry i * k + j counts paths from sources[i] to sinks[j].
+// Groups of CRT_LANES sources run in parallel. prime must be below 2^31.
+std::vector<std::uint32_t> lgv_matrix_mod(const grid& setting, const std::vector<grid_cell>& sources,
+                                          const std::vector<grid_cell>& sinks,
+                                          std::uint32_t prime = LGV_PRIME,
+                                          work_stealing_pool& pool = default_pool()) {
+  assert(sources.size() == sinks.size());
+  assert(prime > 1 && prime < (1u << 31));
+  const size_t k = sources.size();
+  std::vector<std::uint32_t> matrix(k * k);
+  std::vector<std::vector<std::uint32_t>> scratch(pool.size());
+  pool.parallel_for((k + CRT_LANES - 1) / CRT_LANES, [&](size_t group, unsigned worker) {
+    grid_cell lane_sources[CRT_LANES];
+    std::uint32_t modulus[CRT_LANES];
+    for (size_t l = 0; l < CRT_LANES; ++l) {
+      const size_t i = group * CRT_LANES + l;
+      lane_sources[l] = (i < k) ? sources[i] : grid_cell{setting.rows(), 0};
+      modulus[l] = prime;
+    }
+    scratch[worker].resize(setting.columns() * CRT_LANES);
+    std::vector<std::uint32_t> out(k * CRT_LANES);
+    count_lanes_to_sinks(setting, lane_sources, modulus, sinks, scratch[worker].data(),
+                         out.data());
+    for (size_t l = 0; l < CRT_LANES && group * CRT_LANES + l < k; ++l) {
+      for (size_t j = 0; j < k; ++j) {
+        matrix[(group * CRT_LANES + l) * k + j] = out[j * CRT_LANES + l];
+      }
+    }
+  });
+  return matrix;
+}
+
+// The determinant of a row-major k x k matrix modulo prime, by Gaussian
+// elimination.
+std::uint32_t determinant_mod(std::vector<std::uint32_t> matrix, size_t k, std::uint32_t prime) {
+  assert(matrix.size() == k * k);
+  std::uint64_t result = 1;
+  for (size_t p = 0; p < k; ++p) {
+    size_t pivot = p;
+    while (pivot < k && matrix[pivot * k + p] == 0) {
+      ++pivot;
+    }
+    if (pivot == k) {
+      return 0;
+    }
+    if (pivot != p) {
+      std::swap_ranges(&matrix[p * k], &matrix[p * k] + k, &matrix[pivot * k]);
+      result = prime - result;
+    }
+    result = result * matrix[p * k + p] % prime;
+    const std::uint32_t inverse = power_mod32(matrix[p * k + p], prime - 2, prime);
+    for (size_t i = p + 1; i < k; ++i) {
+      const std::uint32_t factor = multiply_mod(matrix[i * k + p], inverse, prime);
+      if (factor == 0) {
+        continue;
+      }
+      for (size_t j = p; j < k; ++j) {
+        matrix[i * k + j] = std::uint32_t(
+            (matrix[i * k + j] + prime - multiply_mod(factor, matrix[p * k + j], prime)) % prime);
+      }
+    }
+  }
+  return std::uint32_t(result % prime);
+}
+
+// The exact matrix of path counts, as for lgv_matrix_mod: the DPs run
+// modulo enough primes for the largest possible entry, one task per source
+// and group of primes, and each entry is rebuilt from its residues.
+std::vector<big_count> lgv_matrix_exact(const grid& setting, const std::vector<grid_cell>& sources,
+                                        const std::vector<grid_cell>& sinks,
+                                        work_stealing_pool& pool = default_pool()) {
+  assert(sources.size() == sinks.size());
+  const size_t k = sources.size();
+
+  // Every path lies in the box from the top-left source to the
+  // bottom-right sink.
+  coordinate top = setting.rows(), left = setting.columns(), bottom = 0, right = 0;
+  for (size_t i = 0; i < k; ++i) {
+    top = std::min(top, sources[i].row);
+    left = std::min(left, sources[i].column);
+    bottom = std::max(bottom, sinks[i].row);
+    right = std::max(right, sinks[i].column);
+  }
+  const auto primes = crt_primes(crt_prime_count(std::max(top, bottom) - top + 1,
+                                                 std::max(left, right) - left + 1));
+  const size_t groups = primes.size() / CRT_LANES;
+
+  // residues[(i * k + j) * primes + q] is entry (i, j) modulo prime q.
+  std::vector<std::uint32_t> residues(k * k * primes.size());
+  std::vector<std::vector<std::uint32_t>> scratch(pool.size());
+  pool.parallel_for(k * groups, [&](size_t task, unsigned worker) {
+    const size_t i = task / groups, group = task % groups;
+    grid_cell lane_sources[CRT_LANES];
+    std::fill(lane_sources, lane_sources + CRT_LANES, sources[i]);
+    scratch[worker].resize(setting.columns() * CRT_LANES);
+    std::vector<std::uint32_t> out(k * CRT_LANES);
+    count_lanes_to_sinks(setting, lane_sources, &primes[group * CRT_LANES], sinks,
+                         scratch[worker].data(), out.data());
+    for (size_t j = 0; j < k; ++j) {
+      std::copy(&out[j * CRT_LANES], &out[j * CRT_LANES] + CRT_LANES,
+                &residues[(i * k + j) * primes.size() + group * CRT_LANES]);
+    }
+  });
+
+  std::vector<big_count> matrix(k * k);
+  pool.parallel_for(k * k, [&](size_t entry, unsigned) {
+    matrix[entry] = crt_reconstruct(
+        std::vector<std::uint32_t>(&residues[entry * primes.size()],
+                                   &residues[entry * primes.size()] + primes.size()),
+        primes);
+  });
+  return matrix;
+}
+
+// The determinant of a row-major k x k integer matrix by fraction-free
+// Bareiss elimination: after step p every remaining entry is a (p + 1) x
+// (p + 1) minor of the original, so each division by the previous pivot is
+// exact and the entries never grow past the size of the determinant.
+big_integer determinant_bareiss(std::vector<big_integer> matrix, size_t k) {
+  assert(matrix.size() == k * k);
+  if (k == 0) {
+    return big_integer(1);
+  }
+  big_integer previous(1);
+  bool negate = false;
+  for (size_t p = 0; p + 1 < k; ++p) {
+    if (matrix[p * k + p].is_zero()) {
+      size_t pivot = p + 1;
+      while (pivot < k && matrix[pivot * k + p].is_zero()) {
+        ++pivot;
+      }
+      if (pivot == k) {
+        return big_integer(0);
+      }
+      std::swap_ranges(&matrix[p * k], &matrix[p * k] + k, &matrix[pivot * k]);
+      negate = !negate;
+    }
+    for (size_t i = p + 1; i < k; ++i) {
+      for (size_t j = p + 1; j < k; ++j) {
+        matrix[i * k + j] = divide_exact(matrix[i * k + j] * matrix[p * k + p] -
+                                         matrix[i * k + p] * matrix[p * k + j], previous);
+      }
+      matrix[i * k + p] = big_integer(0);
+    }
+    previous = matrix[p * k + p];
+  }
+  const big_integer& result = matrix[k * k - 1];
+  return negate ? -result : result;
+}
+
+// The LGV determinant for these sources and sinks modulo prime: the
+// number of convoys when the endpoints are ordered as described at the
+// top of this file, modulo prime.
+std::uint32_t count_disjoint_paths_mod(const grid& setting, const std::vector<grid_cell>& sources,
+                                       const std::vector<grid_cell>& sinks,
+                                       std::uint32_t prime = LGV_PRIME,
+                                       work_stealing_pool& pool = default_pool()) {
+  return determinant_mod(lgv_matrix_mod(setting, sources, sinks, prime, pool), sources.size(),
+                         prime);
+}
+
+// The exact LGV determinant for these sources and sinks.
+big_integer count_disjoint_paths_exact(const grid& setting, const std::vector<grid_cell>& sources,
+                                       const std::vector<grid_cell>& sinks,
+                                       work_stealing_pool& pool = default_pool()) {
+  auto counts = lgv_matrix_exact(setting, sources, sinks, pool);
+  return determinant_bareiss(std::vector<big_integer>(counts.begin(), counts.end()),
+                             sources.size());
+}
+
+// Every path from (row, column) to target, as lists of cell indices
+// row * columns + column, appended to paths.
+void enumerate_cell_paths(const grid& setting, coordinate row, coordinate column,
+                          const grid_cell& target, std::vector<size_t>& prefix,
+                          std::vector<std::vector<size_t>>& paths) {
+  prefix.push_back(row * setting.columns() + column);
+  if (row == target.row && column == target.column) {
+    paths.push_back(prefix);
+  } else {
+    if (column < target.column && setting.may_step(row, column + 1)) {
+      enumerate_cell_paths(setting, row, column + 1, target, prefix, paths);
+    }
+    if (row < target.row && setting.may_step(row + 1, column)) {
+      enumerate_cell_paths(setting, row + 1, column, target, prefix, paths);
+    }
+  }
+  prefix.pop_back();
+}
+
+// Number of tuples of pairwise disjoint paths, the i-th chosen from
+// options[i], that avoid the cells already marked in used.
+long long count_disjoint_choices(const std::vector<const std::vector<std::vector<size_t>>*>& options,
+                                 size_t i, std::vector<char>& used) {
+  if (i == options.size()) {
+    return 1;
+  }
+  long long total = 0;
+  for (const auto& candidate : *options[i]) {
+    if (std::any_of(candidate.begin(), candidate.end(), [&](size_t cell) { return used[cell]; })) {
+      continue;
+    }
+    for (size_t cell : candidate) {
+      used[cell] = 1;
+    }
+    total += count_disjoint_choices(options, i + 1, used);
+    for (size_t cell : candidate) {
+      used[cell] = 0;
+    }
+  }
+  return total;
+}
+
+// The signed sum over permutations from the LGV lemma, computed directly
+// by enumerating every path between every source and sink and every
+// combination of them. This takes exponential time, and is meant only as
+// an oracle for tiny grids.
+long long count_disjoint_paths_exhaustive(const grid& setting,
+                                          const std::vector<grid_cell>& sources,
+                                          const std::vector<grid_cell>& sinks) {
+  assert(sources.size() == sinks.size());
+  const size_t k = sources.size();
+  std::vector<std::vector<std::vector<size_t>>> paths(k * k);
+  std::vector<size_t> prefix;
+  for (size_t i = 0; i < k; ++i) {
+    if (setting.get(sources[i].row, sources[i].column) != CELL_WATER) {
+      continue;
+    }
+    for (size_t j = 0; j < k; ++j) {
+      enumerate_cell_paths(setting, sources[i].row, sources[i].column, sinks[j], prefix,
+                           paths[i * k + j]);
+    }
+  }
+
+  std::vector<size_t> permutation(k);
+  for (size_t i = 0; i < k; ++i) {
+    permutation[i] = i;
+  }
+  std::vector<char> used(setting.rows() * setting.columns(), 0);
+  long long total = 0;
+  do {
+    size_t inversions = 0;
+    std::vector<const std::vector<std::vector<size_t>>*> options(k);
+    for (size_t i = 0; i < k; ++i) {
+      options[i] = &paths[i * k + permutation[i]];
+      for (size_t j = i + 1; j < k; ++j) {
+        inversions += (permutation[j] < permutation[i]) ? 1 : 0;
+      }
+    }
+    const long long tuples = count_disjoint_choices(options, 0, used);
+    total += (inversions % 2 == 0) ? tuples : -tuples;
+  } while (std::next_permutation(permutation.begin(), permutation.end()));
+  return total;
+}
+
+}
@@ -0,0 +1,291 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_dynamic.hpp
+//
+// Path counting on grids that change a few cells at a time.
+//
+// For a grid of width w, the effect of one row on the count row above it is
+// a linear map: entry (c, j) of its w x w transfer matrix is 1 when j <= c
+// and cells j..c of the row are all water, and 0 otherwise. The count for
+// the whole grid is entry (w-1, 0) of the product of every row's matrix.
+//
+// dynamic_path_counter keeps these products in a segment tree over blocks
+// of rows, so changing one cell only recomputes one leaf block and the
+// O(log rows) products above it.
+//
+// variant_solver answers many what-if variants of one base grid, each
+// differing in a few cells, by resuming the base DP from a stored
+// checkpoint instead of starting over.
+//
+// Counts are modulo 2^32, like iceberg_avoiding_dyn_prog.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "ices_algs.hpp"
+#include "ices_parallel.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+class dynamic_path_counter {
+public:
+  // Widest grid supported.
+  static constexpr coordinate MAX_COLUMNS = 64;
+
+private:
+  grid setting_;
+  coordinate width_;
+
+  // Matrices are stored row-major with stride_ entries per row, stride_
+  // being width_ rounded up to a multiple of 8 so every row of the inner
+  // loops is a whole number of SIMD vectors. Padding entries stay 0.
+  coordinate stride_;
+  coordinate leaf_rows_, leaves_;
+
+  // Node 1 is the root, node i has children 2i and 2i+1, and leaf k is node
+  // leaves_ + k. Each node holds the product of its rows' matrices, later
+  // rows on the left.
+  std::vector<std::uint32_t> nodes_;
+
+  std::uint32_t* node(size_t index) { return &nodes_[index * stride_ * stride_]; }
+  const std::uint32_t* node(size_t index) const { return &nodes_[index * stride_ * stride_]; }
+
+  // Apply the transfer matrix of one grid row to m in place: along each
+  // column of m, a running sum that resets at every iceberg. The work is
+  // done a whole matrix row at a time so it vectorizes.
+  void apply_row(coordinate row, std::uint32_t* __restrict m) const {
+    const grid_word cells = setting_.row_words(row)[0];
+    std::uint32_t from_left[MAX_COLUMNS + 8] = {};
+    for (coordinate c = 0; c < width_; ++c) {
+      std::uint32_t* __restrict out = m + c * stride_;
+      const std::uint32_t water = std::uint32_t(((cells >> c) & 1) ^ 1);
+      const std::uint32_t mask = 0u - water;
+      for (coordinate j = 0; j < stride_; ++j) {
+        from_left[j] = (from_left[j] + out[j]) & mask;
+        out[j] = from_left[j];
+      }
+    }
+  }
+
+  // out = a * b.
+  void multiply(const std::uint32_t* __restrict a, const std::uint32_t* __restrict b,
+                std::uint32_t* __restrict out) const {
+    std::fill(out, out + stride_ * stride_, 0);
+    for (coordinate i = 0; i < width_; ++i) {
+      std::uint32_t* __restrict out_row = out + i * stride_;
+      for (coordinate k = 0; k < width_; ++k) {
+        const std::uint32_t scale = a[i * stride_ + k];
+        if (scale == 0) {
+          continue;
+        }
+        const std::uint32_t* __restrict b_row = b + k * stride_;
+        for (coordinate j = 0; j < stride_; ++j) {
+          out_row[j] += scale * b_row[j];
+        }
+      }
+    }
+  }
+
+  void rebuild_leaf(coordinate leaf) {
+    std::uint32_t* m = node(leaves_ + leaf);
+    std::fill(m, m + stride_ * stride_, 0);
+    for (coordinate c = 0; c < width_; ++c) {
+      m[c * stride_ + c] = 1;
+    }
+    coordinate first = leaf * leaf_rows_,
+               end = std::min(setting_.rows(), first + leaf_rows_);
+    for (coordinate r = first; r < end; ++r) {
+      apply_row(r, m);
+    }
+  }
+
+  void rebuild_internal(size_t index) {
+    multiply(node(2 * index + 1), node(2 * index), node(index));
+  }
+
+public:
+
+  // Build the tree for the given grid, which must have at most MAX_COLUMNS
+  // columns. Each leaf covers leaf_rows rows; larger leaves save memory
+  // and make updates cost more row applications.
+  explicit dynamic_path_counter(const grid& setting, coordinate leaf_rows = 16)
+  : setting_(setting), width_(setting.columns()),
+    stride_((setting.columns() + 7) / 8 * 8), leaf_rows_(leaf_rows), leaves_(1) {
+
+    assert(width_ <= MAX_COLUMNS);
+    assert(leaf_rows > 0);
+
+    coordinate blocks = (setting.rows() + leaf_rows - 1) / leaf_rows;
+    while (leaves_ < blocks) {
+      leaves_ *= 2;
+    }
+    nodes_.assign(2 * leaves_ * stride_ * stride_, 0);
+    // Blocks past the last row are left as identity matrices.
+    for (coordinate leaf = 0; leaf < leaves_; ++leaf) {
+      rebuild_leaf(leaf);
+    }
+    for (size_t index = leaves_; index-- > 1; ) {
+      rebuild_internal(index);
+    }
+  }
+
+  const grid& setting() const { return setting_; }
+
+  // The number of valid paths in the current grid, modulo 2^32.
+  unsigned int count() const {
+    return node(1)[(width_ - 1) * stride_ + 0];
+  }
+
+  // Change one cell, with the same rules as grid::set, and update the
+  // counts in O(leaf_rows * w^2 + w^3 log rows) time.
+  void set(coordinate row, coordinate column, cell_kind kind) {
+    if (setting_.get(row, column) == kind) {
+      return;
+    }
+    setting_.set(row, column, kind);
+    coordinate leaf = row / leaf_rows_;
+    rebuild_leaf(leaf);
+    for (size_t index = (leaves_ + leaf) / 2; index >= 1; index /= 2) {
+      rebuild_internal(index);
+    }
+  }
+
+  // Flip one cell between CELL_WATER and CELL_ICEBERG.
+  void toggle(coordinate row, coordinate column) {
+    set(row, column, (setting_.get(row, column) == CELL_WATER) ? CELL_ICEBERG : CELL_WATER);
+  }
+};
+
+// One changed cell of a variant grid.
+struct cell_change {
+  coordinate row, column;
+  cell_kind kind;
+};
+
+// Counts paths in variants of a base grid.
+//
+// The base DP is run once, keeping the count row at every interval-th row
+// as a checkpoint. For a variant, the DP restarts at the last checkpoint
+// at or above its first changed row and runs over the changed rows twice,
+// once with and once without the changes. Below the last change the grid
+// is the base grid again, and since the DP is linear only the difference
+// between the variant and base count rows needs to be carried on. That
+// difference is nonzero only in a range of columns that never moves left
+// and is cut short by icebergs, so only that range is computed, and the
+// work stops early if the difference dies out. The variant's count is the
+// base count plus the difference that reaches the goal.
+class variant_solver {
+private:
+  const grid* base_;
+  coordinate interval_;
+  std::vector<std::vector<unsigned int>> checkpoints_;
+  unsigned int base_count_;
+
+public:
+
+  // Run the base DP. interval of 0 means about sqrt(rows). The base grid
+  // must outlive the solver.
+  explicit variant_solver(const grid& base, coordinate interval = 0)
+  : base_(&base), interval_(interval) {
+    const coordinate rows = base.rows(), columns = base.columns();
+    if (interval_ == 0) {
+      interval_ = std::max<coordinate>(1, coordinate(std::sqrt(double(rows))));
+    }
+    std::vector<unsigned int> counts(columns, 0);
+    counts[0] = 1;
+    for (coordinate r = 0; r < rows; ++r) {
+      if (r % interval_ == 0) {
+        checkpoints_.push_back(counts);
+      }
+      advance_count_row(base.row_words(r), counts.data(), columns);
+    }
+    base_count_ = counts[columns - 1];
+  }
+
+  const grid& base() const { return *base_; }
+
+  // The number of valid paths in the base grid, modulo 2^32.
+  unsigned int base_count() const { return base_count_; }
+
+  // The number of valid paths in the base grid with the given cells
+  // changed, modulo 2^32. (0, 0) may not be changed to CELL_ICEBERG.
+  unsigned int count(std::vector<cell_change> changes) const {
+    const grid& base = *base_;
+    const coordinate rows = base.rows(), columns = base.columns(),
+                     words = words_per_row(columns);
+    if (changes.empty()) {
+      return base_count_;
+    }
+    std::stable_sort(changes.begin(), changes.end(), [](const cell_change& a, const cell_change& b) {
+      return a.row < b.row;
+    });
+    for (auto& change : changes) {
+      assert(base.is_row_column(change.row, change.column));
+      assert(change.row != 0 || change.column != 0 || change.kind == CELL_WATER);
+    }
+
+    // Run both DPs from the checkpoint through the last changed row.
+    const coordinate start = changes.front().row / interval_ * interval_;
+    std::vector<unsigned int> variant = checkpoints_[start / interval_],
+                              original = variant;
+    std::vector<grid_word> cells(words);
+    auto next_change = changes.begin();
+    for (coordinate r = start; r <= changes.back().row; ++r) {
+      std::copy(base.row_words(r), base.row_words(r) + words, cells.begin());
+      for (; next_change != changes.end() && next_change->row == r; ++next_change) {
+        grid_word bit = grid_word(1) << (next_change->column % GRID_WORD_BITS);
+        grid_word& word = cells[next_change->column / GRID_WORD_BITS];
+        word = (next_change->kind == CELL_ICEBERG) ? (word | bit) : (word & ~bit);
+      }
+      advance_count_row(cells.data(), variant.data(), columns);
+      advance_count_row(base.row_words(r), original.data(), columns);
+    }
+
+    // variant now holds the difference, nonzero within [low, high].
+    coordinate low = columns, high = 0;
+    for (coordinate c = 0; c < columns; ++c) {
+      variant[c] -= original[c];
+      if (variant[c] != 0) {
+        low = std::min(low, c);
+        high = c;
+      }
+    }
+    for (coordinate r = changes.back().row + 1; r < rows && low <= high; ++r) {
+      const grid_word* row = base.row_words(r);
+      unsigned int from_left = 0;
+      coordinate new_low = columns, new_high = 0;
+      for (coordinate c = low; c < columns; ++c) {
+        if (c > high && from_left == 0) {
+          break;
+        }
+        bool iceberg = (row[c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS)) & 1;
+        from_left = iceberg ? 0 : variant[c] + from_left;
+        variant[c] = from_left;
+        if (from_left != 0) {
+          new_low = std::min(new_low, c);
+          new_high = c;
+        }
+      }
+      low = new_low;
+      high = new_high;
+    }
+    // Outside [low, high] the difference is 0, including once it dies out.
+    return base_count_ + variant[columns - 1];
+  }
+
+  // Count every variant, spread across the pool.
+  std::vector<unsigned int> count_all(const std::vector<std::vector<cell_change>>& variants,
+                                      work_stealing_pool& pool = default_pool()) const {
+    std::vector<unsigned int> result(variants.size());
+    pool.parallel_for(variants.size(), [&](size_t i, unsigned) {
+      result[i] = count(variants[i]);
+    });
+    return result;
+  }
+};
+
+}
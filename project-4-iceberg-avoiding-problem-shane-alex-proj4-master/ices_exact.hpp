@@ -0,0 +1,519 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_exact.hpp
+//
+// Exact path counts, however many digits they have.
+//
+// The number of paths through a rows x columns grid is at most
+// C(rows + columns - 2, rows - 1), which for large grids has hundreds or
+// thousands of digits. A DP over big integers pays for every digit at
+// every cell. Instead, the rolling DP is run modulo several 31-bit primes
+// whose product exceeds that bound, and the exact count is rebuilt from
+// the residues with the Chinese remainder theorem at the end.
+//
+// The DP only adds, and modular addition needs no multiplications, so the
+// primes are handled CRT_LANES at a time in interleaved lanes, entry c of
+// prime l at counts[c * CRT_LANES + l] as in ices_batch.hpp: one pass over
+// the grid advances every lane with the same vector instructions. Groups
+// of lanes are independent and run in parallel.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "ices_parallel.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// An arbitrarily large unsigned integer, as little-endian 32-bit limbs.
+class big_count {
+private:
+  std::vector<std::uint32_t> limbs_;
+
+  void trim() {
+    while (!limbs_.empty() && limbs_.back() == 0) {
+      limbs_.pop_back();
+    }
+  }
+
+public:
+
+  big_count(std::uint64_t value = 0) {
+    for (; value != 0; value >>= 32) {
+      limbs_.push_back(std::uint32_t(value));
+    }
+  }
+
+  // Take the given limbs, least significant first.
+  explicit big_count(std::vector<std::uint32_t>&& limbs)
+  : limbs_(std::move(limbs)) {
+    trim();
+  }
+
+  const std::vector<std::uint32_t>& limbs() const { return limbs_; }
+  bool is_zero() const { return limbs_.empty(); }
+
+  // The value modulo 2^32, what the other solvers return.
+  unsigned int low32() const { return limbs_.empty() ? 0 : limbs_[0]; }
+
+  // Number of significant bits.
+  size_t bits() const {
+    return limbs_.empty() ? 0 : 32 * limbs_.size() - __builtin_clz(limbs_.back());
+  }
+
+  big_count& operator+=(const big_count& o) {
+    if (limbs_.size() < o.limbs_.size()) {
+      limbs_.resize(o.limbs_.size(), 0);
+    }
+    std::uint64_t carry = 0;
+    for (size_t i = 0; i < limbs_.size(); ++i) {
+      carry += std::uint64_t(limbs_[i]) + (i < o.limbs_.size() ? o.limbs_[i] : 0);
+      limbs_[i] = std::uint32_t(carry);
+      carry >>= 32;
+    }
+    if (carry) {
+      limbs_.push_back(std::uint32_t(carry));
+    }
+    return *this;
+  }
+
+  // Set this to this * factor + addend.
+  void multiply_add(std::uint32_t factor, std::uint32_t addend) {
+    std::uint64_t carry = addend;
+    for (auto& limb : limbs_) {
+      carry += std::uint64_t(limb) * factor;
+      limb = std::uint32_t(carry);
+      carry >>= 32;
+    }
+    if (carry) {
+      limbs_.push_back(std::uint32_t(carry));
+    }
+    trim();
+  }
+
+  // Divide by divisor in place, returning the remainder.
+  std::uint32_t divide(std::uint32_t divisor) {
+    assert(divisor != 0);
+    std::uint64_t remainder = 0;
+    for (size_t i = limbs_.size(); i-- > 0; ) {
+      std::uint64_t current = (remainder << 32) | limbs_[i];
+      limbs_[i] = std::uint32_t(current / divisor);
+      remainder = current % divisor;
+    }
+    trim();
+    return std::uint32_t(remainder);
+  }
+
+  // Decimal representation.
+  std::string to_string() const {
+    if (limbs_.empty()) {
+      return "0";
+    }
+    // Peel off nine decimal digits at a time.
+    big_count rest = *this;
+    std::string digits;
+    while (!rest.is_zero()) {
+      std::uint32_t chunk = rest.divide(1000000000);
+      for (int k = 0; k < 9 && (chunk != 0 || !rest.is_zero()); ++k, chunk /= 10) {
+        digits.push_back(char('0' + chunk % 10));
+      }
+    }
+    std::reverse(digits.begin(), digits.end());
+    return digits;
+  }
+
+  // Subtract o, which must not exceed this.
+  big_count& operator-=(const big_count& o) {
+    assert(!(*this < o));
+    std::uint64_t borrow = 0;
+    for (size_t i = 0; i < limbs_.size(); ++i) {
+      std::uint64_t subtrahend = (i < o.limbs_.size() ? o.limbs_[i] : 0) + borrow;
+      borrow = (limbs_[i] < subtrahend) ? 1 : 0;
+      limbs_[i] = std::uint32_t(limbs_[i] - subtrahend);
+    }
+    trim();
+    return *this;
+  }
+
+  // Schoolbook product.
+  big_count operator*(const big_count& o) const {
+    if (is_zero() || o.is_zero()) {
+      return big_count();
+    }
+    std::vector<std::uint32_t> product(limbs_.size() + o.limbs_.size(), 0);
+    for (size_t i = 0; i < limbs_.size(); ++i) {
+      std::uint64_t carry = 0;
+      for (size_t j = 0; j < o.limbs_.size(); ++j) {
+        carry += std::uint64_t(limbs_[i]) * o.limbs_[j] + product[i + j];
+        product[i + j] = std::uint32_t(carry);
+        carry >>= 32;
+      }
+      product[i + o.limbs_.size()] = std::uint32_t(carry);
+    }
+    return big_count(std::move(product));
+  }
+
+  // Divide by divisor, which must divide this exactly. Exactness allows
+  // Jebelean's method: once both are shifted to make the divisor odd, each
+  // quotient limb, lowest first, is the lowest remaining limb times the
+  // inverse of the divisor's lowest limb modulo 2^32, and no trial
+  // quotients or corrections are needed.
+  void divide_exact(big_count divisor) {
+    assert(!divisor.is_zero());
+    if (is_zero()) {
+      return;
+    }
+    size_t zeros = 0;
+    while (((divisor.limbs_[zeros / 32] >> (zeros % 32)) & 1) == 0) {
+      ++zeros;
+    }
+    shift_right(zeros);
+    divisor.shift_right(zeros);
+    assert(limbs_.size() >= divisor.limbs_.size());
+
+    // Newton's iteration doubles the correct low bits of the inverse; an
+    // odd number is its own inverse modulo 8.
+    const std::uint32_t low = divisor.limbs_[0];
+    std::uint32_t inverse = low;
+    for (int k = 0; k < 4; ++k) {
+      inverse *= 2 - low * inverse;
+    }
+
+    const size_t n = limbs_.size(), m = divisor.limbs_.size();
+    std::vector<std::uint32_t> quotient(n - m + 1);
+    for (size_t i = 0; i < quotient.size(); ++i) {
+      const std::uint32_t digit = limbs_[i] * inverse;
+      quotient[i] = digit;
+      // Subtract digit * divisor * 2^(32 i), dropping anything above the
+      // top limb, which an exact quotient never needs.
+      std::uint64_t carry = 0, borrow = 0;
+      for (size_t j = 0; i + j < n && (j < m || carry != 0 || borrow != 0); ++j) {
+        carry += (j < m) ? std::uint64_t(digit) * divisor.limbs_[j] : 0;
+        std::uint64_t subtrahend = (carry & 0xffffffffu) + borrow;
+        carry >>= 32;
+        borrow = (limbs_[i + j] < subtrahend) ? 1 : 0;
+        limbs_[i + j] = std::uint32_t(limbs_[i + j] - subtrahend);
+      }
+    }
+    limbs_ = std::move(quotient);
+    trim();
+  }
+
+  // Divide by 2^count.
+  void shift_right(size_t count) {
+    const size_t whole = std::min(count / 32, limbs_.size()), part = count % 32;
+    limbs_.erase(limbs_.begin(), limbs_.begin() + whole);
+    if (part != 0) {
+      for (size_t i = 0; i < limbs_.size(); ++i) {
+        std::uint32_t above = (i + 1 < limbs_.size()) ? limbs_[i + 1] : 0;
+        limbs_[i] = (limbs_[i] >> part) | (above << (32 - part));
+      }
+    }
+    trim();
+  }
+
+  bool operator==(const big_count& o) const { return limbs_ == o.limbs_; }
+  bool operator!=(const big_count& o) const { return !(*this == o); }
+  bool operator<(const big_count& o) const {
+    if (limbs_.size() != o.limbs_.size()) {
+      return limbs_.size() < o.limbs_.size();
+    }
+    return std::lexicographical_compare(limbs_.rbegin(), limbs_.rend(),
+                                        o.limbs_.rbegin(), o.limbs_.rend());
+  }
+};
+
+inline std::ostream& operator<<(std::ostream& out, const big_count& value) {
+  return out << value.to_string();
+}
+
+// A signed big integer, as a sign and a magnitude, for computations such
+// as determinants whose intermediate values can be negative. Zero is never
+// negative.
+struct big_integer {
+  bool negative = false;
+  big_count magnitude;
+
+  big_integer(std::int64_t value = 0)
+  : negative(value < 0),
+    magnitude(value < 0 ? 0 - std::uint64_t(value) : std::uint64_t(value)) { }
+
+  big_integer(const big_count& value, bool is_negative = false)
+  : negative(is_negative && !value.is_zero()), magnitude(value) { }
+
+  bool is_zero() const { return magnitude.is_zero(); }
+
+  // The value modulo m, in [0, m).
+  std::uint32_t residue(std::uint32_t m) const {
+    big_count copy = magnitude;
+    std::uint32_t r = copy.divide(m);
+    return (negative && r != 0) ? m - r : r;
+  }
+
+  std::string to_string() const {
+    return (negative ? "-" : "") + magnitude.to_string();
+  }
+
+  bool operator==(const big_integer& o) const {
+    return negative == o.negative && magnitude == o.magnitude;
+  }
+  bool operator!=(const big_integer& o) const { return !(*this == o); }
+};
+
+inline big_integer operator-(const big_integer& a) {
+  return big_integer(a.magnitude, !a.negative);
+}
+
+inline big_integer operator*(const big_integer& a, const big_integer& b) {
+  return big_integer(a.magnitude * b.magnitude, a.negative != b.negative);
+}
+
+big_integer operator-(const big_integer& a, const big_integer& b) {
+  if (a.negative != b.negative) {
+    // Opposite signs: the magnitudes add, and a's sign wins.
+    big_count sum = a.magnitude;
+    sum += b.magnitude;
+    return big_integer(sum, a.negative);
+  }
+  if (a.magnitude < b.magnitude) {
+    big_count difference = b.magnitude;
+    difference -= a.magnitude;
+    return big_integer(difference, !a.negative);
+  }
+  big_count difference = a.magnitude;
+  difference -= b.magnitude;
+  return big_integer(difference, a.negative);
+}
+
+// a / b, where b must divide a exactly.
+big_integer divide_exact(const big_integer& a, const big_integer& b) {
+  big_count quotient = a.magnitude;
+  quotient.divide_exact(b.magnitude);
+  return big_integer(quotient, a.negative != b.negative);
+}
+
+inline std::ostream& operator<<(std::ostream& out, const big_integer& value) {
+  return out << value.to_string();
+}
+
+// log2 of C(rows + columns - 2, rows - 1), the number of paths through an
+// empty rows x columns grid and so an upper bound for any grid that size.
+double log2_path_bound(coordinate rows, coordinate columns) {
+  assert(rows > 0 && columns > 0);
+  const double n = double(rows + columns - 2), k = double(rows - 1);
+  return (std::lgamma(n + 1) - std::lgamma(k + 1) - std::lgamma(n - k + 1)) / std::log(2.0);
+}
+
+// Number of primes the CRT solvers use per interleaved group.
+const size_t CRT_LANES = 8;
+
+// a * b modulo m.
+inline std::uint32_t multiply_mod(std::uint64_t a, std::uint64_t b, std::uint32_t m) {
+  return std::uint32_t(a * b % m);
+}
+
+inline std::uint32_t power_mod32(std::uint32_t a, std::uint64_t e, std::uint32_t m) {
+  std::uint32_t result = 1 % m;
+  for (; e > 0; e >>= 1, a = multiply_mod(a, a, m)) {
+    if (e & 1) {
+      result = multiply_mod(result, a, m);
+    }
+  }
+  return result;
+}
+
+// Deterministic Miller-Rabin for 32-bit numbers; bases 2, 7 and 61 suffice.
+bool is_prime32(std::uint32_t n) {
+  if (n < 2) {
+    return false;
+  }
+  for (std::uint32_t p : {2u, 3u, 5u, 7u, 61u}) {
+    if (n % p == 0) {
+      return n == p;
+    }
+  }
+  std::uint32_t d = n - 1;
+  unsigned s = 0;
+  for (; d % 2 == 0; d /= 2) {
+    ++s;
+  }
+  for (std::uint32_t a : {2u, 7u, 61u}) {
+    std::uint32_t x = power_mod32(a, d, n);
+    if (x == 1 || x == n - 1) {
+      continue;
+    }
+    bool composite = true;
+    for (unsigned i = 1; i < s && composite; ++i) {
+      x = multiply_mod(x, x, n);
+      composite = (x != n - 1);
+    }
+    if (composite) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The count largest primes below 2^31, in decreasing order. Sums of two
+// residues then still fit in 32 bits.
+std::vector<std::uint32_t> crt_primes(size_t count) {
+  std::vector<std::uint32_t> primes;
+  for (std::uint32_t n = (1u << 31) - 1; primes.size() < count; n -= 2) {
+    if (is_prime32(n)) {
+      primes.push_back(n);
+    }
+  }
+  return primes;
+}
+
+// Number of primes needed for a rows x columns grid: their product, each
+// prime above 2^30.9, must exceed the path bound. A spare prime covers
+// rounding in log2_path_bound. Rounded up to whole lane groups, which
+// cost nothing extra.
+size_t crt_prime_count(coordinate rows, coordinate columns) {
+  size_t needed = size_t(std::ceil((log2_path_bound(rows, columns) + 1) / 30.9)) + 1;
+  return (needed + CRT_LANES - 1) / CRT_LANES * CRT_LANES;
+}
+
+// With GCC on x86-64, compile the lane kernel for AVX2 as well as the
+// baseline instruction set, and pick one when the program starts, so that
+// eight lanes fit in one vector register on processors that have it.
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(__clang__)
+#define ICES_LANE_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define ICES_LANE_CLONES
+#endif
+
+// Run the rolling DP over a grid modulo the CRT_LANES primes in modulus,
+// writing the count modulo each to residues. counts is scratch space for
+// columns * CRT_LANES entries.
+ICES_LANE_CLONES
+void count_paths_lanes(const grid& setting, const std::uint32_t* modulus,
+                       std::uint32_t* __restrict counts, std::uint32_t* residues) {
+  const coordinate rows = setting.rows(), columns = setting.columns();
+  std::fill(counts, counts + columns * CRT_LANES, 0);
+  for (size_t l = 0; l < CRT_LANES; ++l) {
+    counts[l] = 1;
+  }
+  std::uint32_t primes[CRT_LANES];
+  std::copy(modulus, modulus + CRT_LANES, primes);
+  for (coordinate r = 0; r < rows; ++r) {
+    const grid_word* icebergs = setting.row_words(r);
+    std::uint32_t from_left[CRT_LANES] = {};
+    for (coordinate c = 0; c < columns; ++c) {
+      const std::uint32_t mask =
+          0u - std::uint32_t(((icebergs[c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS)) & 1) ^ 1);
+      std::uint32_t* lanes = counts + c * CRT_LANES;
+      for (size_t l = 0; l < CRT_LANES; ++l) {
+        // Both terms are below the prime, so the sum fits, and subtracting
+        // the prime wraps around exactly when the sum was already reduced.
+        std::uint32_t sum = from_left[l] + lanes[l];
+        sum = std::min(sum, sum - primes[l]);
+        from_left[l] = sum & mask;
+        lanes[l] = from_left[l];
+      }
+    }
+  }
+  std::copy(counts + (columns - 1) * CRT_LANES, counts + columns * CRT_LANES, residues);
+}
+
+// Run the rolling DP modulo each of primes, whose count must be a multiple
+// of CRT_LANES, and return the count modulo each prime.
+std::vector<std::uint32_t> count_paths_residues(const grid& setting,
+                                                const std::vector<std::uint32_t>& primes,
+                                                work_stealing_pool& pool = default_pool()) {
+  assert(primes.size() % CRT_LANES == 0);
+  std::vector<std::uint32_t> residues(primes.size());
+  std::vector<std::vector<std::uint32_t>> scratch(pool.size());
+  pool.parallel_for(primes.size() / CRT_LANES, [&](size_t group, unsigned worker) {
+    scratch[worker].resize(setting.columns() * CRT_LANES);
+    count_paths_lanes(setting, &primes[group * CRT_LANES], scratch[worker].data(),
+                      &residues[group * CRT_LANES]);
+  });
+  return residues;
+}
+
+// Rebuild the number that has the given residues modulo the given distinct
+// primes and is below their product, by Garner's mixed-radix algorithm.
+big_count crt_reconstruct(const std::vector<std::uint32_t>& residues,
+                          const std::vector<std::uint32_t>& primes) {
+  assert(residues.size() == primes.size());
+  const size_t k = primes.size();
+  // x = d[0] + d[1] p[0] + d[2] p[0] p[1] + ..., with d[i] < p[i].
+  std::vector<std::uint32_t> digits(k);
+  for (size_t i = 0; i < k; ++i) {
+    const std::uint32_t p = primes[i];
+    // Evaluate the digits so far modulo p, and the product of the earlier
+    // primes modulo p.
+    std::uint32_t value = 0, product = 1;
+    for (size_t j = 0; j < i; ++j) {
+      value = std::uint32_t((value + std::uint64_t(digits[j]) * product) % p);
+      product = multiply_mod(product, primes[j] % p, p);
+    }
+    std::uint32_t difference = std::uint32_t((std::uint64_t(residues[i]) % p + p - value) % p);
+    digits[i] = multiply_mod(difference, power_mod32(product, p - 2, p), p);
+  }
+  big_count result;
+  for (size_t i = k; i-- > 0; ) {
+    result.multiply_add(primes[i], digits[i]);
+  }
+  return result;
+}
+
+// The exact number of paths from (0, 0) to the bottom-right corner, by the
+// rolling DP modulo enough primes and the Chinese remainder theorem.
+//
+// The grid must be non-empty.
+big_count iceberg_avoiding_exact(const grid& setting, work_stealing_pool& pool = default_pool()) {
+
+  // grid must be non-empty.
+  assert(setting.rows() > 0);
+  assert(setting.columns() > 0);
+
+  auto primes = crt_primes(crt_prime_count(setting.rows(), setting.columns()));
+  return crt_reconstruct(count_paths_residues(setting, primes, pool), primes);
+}
+
+// The exact number of paths by the rolling DP over fixed-width big
+// integers, sized from the path bound: limbs 32-bit limbs per column,
+// added with carries at every cell. For comparison with
+// iceberg_avoiding_exact.
+//
+// The grid must be non-empty.
+big_count iceberg_avoiding_bigint(const grid& setting) {
+
+  // grid must be non-empty.
+  assert(setting.rows() > 0);
+  assert(setting.columns() > 0);
+
+  const coordinate rows = setting.rows(), columns = setting.columns();
+  const size_t limbs = size_t(log2_path_bound(rows, columns) / 32) + 2;
+  std::vector<std::uint32_t> counts(columns * limbs, 0), from_left(limbs);
+  counts[0] = 1;
+  for (coordinate r = 0; r < rows; ++r) {
+    std::fill(from_left.begin(), from_left.end(), 0);
+    for (coordinate c = 0; c < columns; ++c) {
+      std::uint32_t* cell = &counts[c * limbs];
+      if (setting.get(r, c) == CELL_ICEBERG) {
+        std::fill(from_left.begin(), from_left.end(), 0);
+      } else {
+        std::uint64_t carry = 0;
+        for (size_t i = 0; i < limbs; ++i) {
+          carry += std::uint64_t(from_left[i]) + cell[i];
+          from_left[i] = std::uint32_t(carry);
+          carry >>= 32;
+        }
+      }
+      std::copy(from_left.begin(), from_left.end(), cell);
+    }
+  }
+  return big_count(std::vector<std::uint32_t>(counts.begin() + (columns - 1) * limbs,
+                                              counts.end()));
+}
+
+}
@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_fixed.hpp
+//
+// Grids whose size is fixed at compile time.
+//
+// A fixed_grid holds its bit-packed rows in a std::array, and it and
+// iceberg_avoiding_fixed are constexpr. A grid written out in the source
+// can therefore be solved by the compiler and its count checked with
+// static_assert:
+//
+//   constexpr ices::fixed_grid<3, 4> route({"..X.",
+//                                           "....",
+//                                           "X..."});
+//   static_assert(ices::iceberg_avoiding_fixed(route) == 6, "");
+//
+// At run time the same function needs no allocation, and since every loop
+// bound is a template parameter the compiler can unroll small grids
+// completely.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <array>
+
+#include "ices_types.hpp"
+
+namespace ices {
+
+template <coordinate Rows, coordinate Columns>
+class fixed_grid {
+  static_assert(Rows > 0 && Columns > 0, "grid must be non-empty");
+
+public:
+  static constexpr coordinate STRIDE = words_per_row(Columns);
+
+private:
+  std::array<grid_word, Rows * STRIDE> words_;
+
+public:
+
+  // Create a grid of CELL_WATER.
+  constexpr fixed_grid() : words_{} { }
+
+  // Create a grid from rows of '.' and 'X', as produced by
+  // grid::printable(). Each row must have exactly Columns characters.
+  constexpr fixed_grid(const char* const (&lines)[Rows]) : words_{} {
+    for (coordinate r = 0; r < Rows; ++r) {
+      for (coordinate c = 0; c < Columns; ++c) {
+        assert(lines[r][c] == '.' || lines[r][c] == 'X');
+        if (lines[r][c] == 'X') {
+          set(r, c, CELL_ICEBERG);
+        }
+      }
+      assert(lines[r][Columns] == '\0');
+    }
+  }
+
+  // Copy a grid of the same size.
+  explicit fixed_grid(const grid& setting) : words_{} {
+    assert(setting.rows() == Rows && setting.columns() == Columns);
+    for (coordinate r = 0; r < Rows; ++r) {
+      std::copy(setting.row_words(r), setting.row_words(r) + STRIDE, &words_[r * STRIDE]);
+    }
+  }
+
+  static constexpr coordinate rows() { return Rows; }
+  static constexpr coordinate columns() { return Columns; }
+
+  constexpr const grid_word* row_words(coordinate row) const { return &words_[row * STRIDE]; }
+
+  constexpr cell_kind get(coordinate row, coordinate column) const {
+    assert(row < Rows && column < Columns);
+    return ((words_[row * STRIDE + column / GRID_WORD_BITS] >> (column % GRID_WORD_BITS)) & 1)
+           ? CELL_ICEBERG : CELL_WATER;
+  }
+
+  constexpr void set(coordinate row, coordinate column, cell_kind kind) {
+    assert(row < Rows && column < Columns);
+    const grid_word bit = grid_word(1) << (column % GRID_WORD_BITS);
+    if (kind == CELL_ICEBERG) {
+      words_[row * STRIDE + column / GRID_WORD_BITS] |= bit;
+    } else {
+      words_[row * STRIDE + column / GRID_WORD_BITS] &= ~bit;
+    }
+  }
+
+  // Copy into a grid, for the run-time algorithms.
+  grid to_grid() const {
+    return grid(Rows, Columns, std::vector<grid_word>(words_.begin(), words_.end()));
+  }
+};
+
+// Solve the iceberg avoiding problem for a fixed grid with the rolling DP,
+// modulo 2^32 like iceberg_avoiding_dyn_prog. Usable in constant
+// expressions; at run time it does not allocate.
+template <coordinate Rows, coordinate Columns>
+constexpr unsigned int iceberg_avoiding_fixed(const fixed_grid<Rows, Columns>& setting) {
+  std::array<unsigned int, Columns> counts{};
+  counts[0] = 1;
+  for (coordinate r = 0; r < Rows; ++r) {
+    const grid_word* icebergs = setting.row_words(r);
+    unsigned int from_left = 0;
+    for (coordinate c = 0; c < Columns; ++c) {
+      // All ones on water, all zeros on an iceberg, as in
+      // advance_count_range.
+      unsigned int water =
+          unsigned(((icebergs[c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS)) & 1) ^ 1);
+      from_left = (counts[c] + from_left) & (0u - water);
+      counts[c] = from_left;
+    }
+  }
+  return counts[Columns - 1];
+}
+
+}
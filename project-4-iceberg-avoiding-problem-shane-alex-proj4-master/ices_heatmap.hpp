@@ -0,0 +1,240 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_heatmap.hpp
+//
+// Per-cell path-through counts: for every cell, how many valid paths pass
+// through it. That is the number of paths from (0, 0) to the cell (the
+// forward DP) times the number of paths from the cell to the goal (the
+// backward DP).
+//
+// Counts have hundreds of digits on real maps, so cells are reported as the
+// fraction of all valid paths that pass through them, computed with doubles
+// that are rescaled by a power of two after every row. Multiply by the
+// total number of paths to get a count.
+//
+// Neither count matrix is ever held in full. The backward pass is run once
+// keeping only every s-th row as a checkpoint, s about sqrt(rows); then the
+// grid is swept top-down in segments of s rows, recomputing each segment's
+// backward rows from the checkpoint below it, on another worker, while the
+// forward pass and the products run over the previous segment. Results are
+// produced one row at a time, in order, so they can be streamed to a file.
+// Memory is O(sqrt(rows) * columns).
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+#include "ices_parallel.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// A row of nonnegative doubles that stands for the row of counts
+// values[c] * 2^exponent.
+struct scaled_row {
+  std::vector<double> values;
+  long exponent = 0;
+
+  explicit scaled_row(coordinate columns = 0) : values(columns, 0.0) { }
+
+  // Rescale so the largest value is in [0.5, 1).
+  void normalize() {
+    double largest = 0;
+    for (double v : values) {
+      largest = std::max(largest, v);
+    }
+    if (largest > 0) {
+      int shift;
+      std::frexp(largest, &shift);
+      for (double& v : values) {
+        v = std::ldexp(v, -shift);
+      }
+      exponent += shift;
+    }
+  }
+};
+
+inline bool is_iceberg(const grid_word* row, coordinate column) {
+  return (row[column / GRID_WORD_BITS] >> (column % GRID_WORD_BITS)) & 1;
+}
+
+// Advance forward counts from row-1 to row. Before row 0, counts should be
+// 1 in column 0 and 0 elsewhere.
+void forward_scaled_row(const grid& setting, coordinate row, scaled_row& counts) {
+  const grid_word* cells = setting.row_words(row);
+  double from_left = 0;
+  for (coordinate c = 0; c < setting.columns(); ++c) {
+    from_left = is_iceberg(cells, c) ? 0 : counts.values[c] + from_left;
+    counts.values[c] = from_left;
+  }
+  counts.normalize();
+}
+
+// Advance backward counts from row+1 to row. Before the last row, counts
+// should be 1 in the last column and 0 elsewhere.
+void backward_scaled_row(const grid& setting, coordinate row, scaled_row& counts) {
+  const grid_word* cells = setting.row_words(row);
+  double from_right = 0;
+  for (coordinate c = setting.columns(); c-- > 0; ) {
+    from_right = is_iceberg(cells, c) ? 0 : counts.values[c] + from_right;
+    counts.values[c] = from_right;
+  }
+  counts.normalize();
+}
+
+// Compute the fraction of valid paths through every cell, calling
+// visit(row, fractions) once per row in order from the top, where
+// fractions points to columns() doubles. If the grid has no valid path,
+// every fraction is 0.
+void path_through_rows(const grid& setting,
+                       const std::function<void(coordinate, const double*)>& visit,
+                       work_stealing_pool& pool = default_pool()) {
+
+  const coordinate rows = setting.rows(), columns = setting.columns();
+  const coordinate span = std::max<coordinate>(1, coordinate(std::sqrt(double(rows))));
+  const coordinate segments = (rows + span - 1) / span;
+
+  // checkpoints[k] holds the backward counts of row k * span, for k >= 1,
+  // and checkpoints[segments] the virtual row below the grid.
+  std::vector<scaled_row> checkpoints(segments + 1);
+  scaled_row backward(columns);
+  backward.values[columns - 1] = 1;
+  checkpoints[segments] = backward;
+  for (coordinate r = rows; r-- > 0; ) {
+    backward_scaled_row(setting, r, backward);
+    if (r % span == 0 && r > 0) {
+      checkpoints[r / span] = backward;
+    }
+  }
+  // backward now holds row 0; its first entry is the total.
+  const double total = backward.values[0];
+  const long total_exponent = backward.exponent;
+  checkpoints[0] = scaled_row();
+
+  // Recompute the backward rows of segment k into buffer, from the
+  // checkpoint below the segment.
+  auto recompute = [&](coordinate k, std::vector<scaled_row>& buffer) {
+    coordinate first = k * span, end = std::min(rows, first + span);
+    buffer.resize(span);
+    scaled_row counts = checkpoints[k + 1];
+    for (coordinate r = end; r-- > first; ) {
+      backward_scaled_row(setting, r, counts);
+      buffer[r - first] = counts;
+    }
+  };
+
+  std::vector<scaled_row> buffers[2];
+  recompute(0, buffers[0]);
+  scaled_row forward(columns);
+  forward.values[0] = 1;
+  std::vector<double> fractions(columns);
+
+  for (coordinate k = 0; k < segments; ++k) {
+    task_group next(pool);
+    if (k + 1 < segments) {
+      next.run([&, k]() { recompute(k + 1, buffers[(k + 1) % 2]); });
+    }
+    // The checkpoint is no longer needed once its segment is recomputed.
+    checkpoints[k + 1] = scaled_row();
+
+    auto& segment = buffers[k % 2];
+    coordinate first = k * span, end = std::min(rows, first + span);
+    for (coordinate r = first; r < end; ++r) {
+      forward_scaled_row(setting, r, forward);
+      const auto& back = segment[r - first];
+      for (coordinate c = 0; c < columns; ++c) {
+        fractions[c] = (total > 0)
+          ? std::ldexp(forward.values[c] * back.values[c] / total,
+                       int(forward.exponent + back.exponent - total_exponent))
+          : 0.0;
+      }
+      visit(r, fractions.data());
+    }
+    next.wait();
+  }
+}
+
+// Compute the fraction of valid paths through every cell, as a matrix.
+// Only for grids whose result fits in memory.
+std::vector<std::vector<double>> path_through_map(const grid& setting,
+                                                  work_stealing_pool& pool = default_pool()) {
+  std::vector<std::vector<double>> result(setting.rows());
+  path_through_rows(setting, [&](coordinate r, const double* fractions) {
+    result[r].assign(fractions, fractions + setting.columns());
+  }, pool);
+  return result;
+}
+
+const char HEATMAP_MAGIC[8] = {'I', 'C', 'E', 'H', 'E', 'A', 'T', '1'};
+
+// Write the fraction of valid paths through every cell to a file, one row
+// at a time as it is computed. The file holds the 8 bytes "ICEHEAT1", the
+// rows and columns as little-endian 64-bit numbers, then rows * columns
+// 32-bit floats in row-major order.
+void write_path_through_map(const grid& setting, const std::string& filename,
+                            work_stealing_pool& pool = default_pool()) {
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("cannot create " + filename);
+  }
+  std::uint64_t shape[2] = {setting.rows(), setting.columns()};
+  out.write(HEATMAP_MAGIC, sizeof(HEATMAP_MAGIC));
+  out.write(reinterpret_cast<const char*>(shape), sizeof(shape));
+  std::vector<float> line(setting.columns());
+  path_through_rows(setting, [&](coordinate, const double* fractions) {
+    std::copy(fractions, fractions + line.size(), line.begin());
+    out.write(reinterpret_cast<const char*>(line.data()), line.size() * sizeof(float));
+  }, pool);
+  out.close();
+  if (!out) {
+    throw std::runtime_error("error writing " + filename);
+  }
+}
+
+// One cell of a path-through ranking.
+struct cell_fraction {
+  coordinate row, column;
+  double fraction;
+};
+
+// Return the k cells with the largest fraction of valid paths through them,
+// largest first, ties broken by position. Cells with no paths through them
+// are never returned.
+std::vector<cell_fraction> top_path_through_cells(const grid& setting, size_t k,
+                                                  work_stealing_pool& pool = default_pool()) {
+  auto better = [](const cell_fraction& a, const cell_fraction& b) {
+    if (a.fraction != b.fraction) {
+      return a.fraction > b.fraction;
+    }
+    return (a.row != b.row) ? a.row < b.row : a.column < b.column;
+  };
+  // A heap whose top is the worst of the best k so far.
+  std::priority_queue<cell_fraction, std::vector<cell_fraction>, decltype(better)> best(better);
+  path_through_rows(setting, [&](coordinate r, const double* fractions) {
+    for (coordinate c = 0; c < setting.columns(); ++c) {
+      if (fractions[c] > 0 && k > 0 &&
+          (best.size() < k || better(cell_fraction{r, c, fractions[c]}, best.top()))) {
+        best.push(cell_fraction{r, c, fractions[c]});
+        if (best.size() > k) {
+          best.pop();
+        }
+      }
+    }
+  }, pool);
+  std::vector<cell_fraction> result;
+  while (!best.empty()) {
+    result.push_back(best.top());
+    best.pop();
+  }
+  std::reverse(result.begin(), result.end());
+  return result;
+}
+
+}
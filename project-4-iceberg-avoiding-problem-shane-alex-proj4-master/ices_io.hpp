@@ -0,0 +1,744 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_io.hpp
+//
+// Grid file formats, and a solver that streams a grid from disk one row at
+// a time.
+//
+// Three formats are understood:
+//
+//   text    one line per row, '.' for CELL_WATER and 'X' for CELL_ICEBERG,
+//           exactly as produced by grid::printable().
+//
+//   binary  a 32-byte header followed by the bit-packed rows:
+//             char          magic[8]   "ICEGRID1"
+//             std::uint64_t rows
+//             std::uint64_t columns
+//             std::uint64_t stride     words per row, >= words_per_row(columns)
+//           then rows * stride 64-bit words, laid out as described for
+//           grid_word in ices_types.hpp. The header and the words are in
+//           the machine's native byte order, so files do not move between
+//           machines of different endianness. The rows start at a multiple
+//           of 8 bytes, so a mapped file can be used in place as a grid
+//           view.
+//
+//   rle     run-length encoded, for grids with few icebergs:
+//             char          magic[8]   "ICERLE01"
+//             std::uint64_t rows
+//             std::uint64_t columns
+//             std::uint64_t reserved   0
+//           then for each row the number of iceberg runs, followed by a
+//           (gap, length) pair per run: gap water cells since the end of the
+//           previous run, then length iceberg cells. Every number is an
+//           unsigned LEB128 varint.
+//
+// Malformed or unreadable files are reported with std::runtime_error.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ices_algs.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+const char BINARY_GRID_MAGIC[8] = {'I', 'C', 'E', 'G', 'R', 'I', 'D', '1'};
+const char RLE_GRID_MAGIC[8] = {'I', 'C', 'E', 'R', 'L', 'E', '0', '1'};
+
+struct binary_grid_header {
+  char magic[8];
+  std::uint64_t rows, columns, stride;
+};
+static_assert(sizeof(binary_grid_header) == 32, "header must be packed");
+
+struct rle_grid_header {
+  char magic[8];
+  std::uint64_t rows, columns, reserved;
+};
+static_assert(sizeof(rle_grid_header) == 32, "header must be packed");
+
+// Visit the iceberg runs of one bit-packed row in order, calling
+// visit(first_column, length) for each.
+template <typename Visit>
+void for_each_iceberg_run(const grid_word* row, coordinate columns, Visit&& visit) {
+  coordinate c = 0;
+  while (c < columns) {
+    // Skip to the next set bit, a word at a time.
+    grid_word word = row[c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS);
+    if (word == 0) {
+      c = (c / GRID_WORD_BITS + 1) * GRID_WORD_BITS;
+      continue;
+    }
+    c += __builtin_ctzll(word);
+    if (c >= columns) {
+      break;
+    }
+    coordinate first = c;
+    while (c < columns && ((row[c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS)) & 1)) {
+      ++c;
+    }
+    visit(first, c - first);
+  }
+}
+
+// Set length iceberg bits starting at first in a bit-packed row.
+void set_iceberg_run(grid_word* row, coordinate first, coordinate length) {
+  for (coordinate c = first; c < first + length; ++c) {
+    row[c / GRID_WORD_BITS] |= grid_word(1) << (c % GRID_WORD_BITS);
+  }
+}
+
+// Source of bit-packed rows, read from the top of the grid down.
+class row_reader {
+public:
+  virtual ~row_reader() { }
+
+  // Width of every row.
+  virtual coordinate columns() const = 0;
+
+  // Read the next row into words_per_row(columns()) words. Return false,
+  // leaving row untouched, once every row has been read.
+  virtual bool read_row(grid_word* row) = 0;
+};
+
+// Reads the '.'/'X' text format.
+class text_row_reader : public row_reader {
+private:
+  std::ifstream in_;
+  std::string line_;
+  bool have_line_;
+  coordinate columns_;
+
+  bool next_line() {
+    if (!std::getline(in_, line_)) {
+      return false;
+    }
+    if (!line_.empty() && line_.back() == '\r') {
+      line_.pop_back();
+    }
+    // A trailing blank line ends the grid.
+    return !line_.empty();
+  }
+
+public:
+
+  explicit text_row_reader(const std::string& filename)
+  : in_(filename) {
+    if (!in_) {
+      throw std::runtime_error("cannot open " + filename);
+    }
+    have_line_ = next_line();
+    if (!have_line_) {
+      throw std::runtime_error(filename + ": empty grid");
+    }
+    columns_ = line_.size();
+  }
+
+  coordinate columns() const override { return columns_; }
+
+  bool read_row(grid_word* row) override {
+    if (!have_line_) {
+      return false;
+    }
+    if (line_.size() != columns_) {
+      throw std::runtime_error("text grid rows have different lengths");
+    }
+    std::fill(row, row + words_per_row(columns_), 0);
+    for (coordinate c = 0; c < columns_; ++c) {
+      if (line_[c] == 'X') {
+        row[c / GRID_WORD_BITS] |= grid_word(1) << (c % GRID_WORD_BITS);
+      } else if (line_[c] != '.') {
+        throw std::runtime_error("text grid contains a character other than '.' or 'X'");
+      }
+    }
+    have_line_ = next_line();
+    return true;
+  }
+};
+
+// Reads the bit-packed binary format.
+class binary_row_reader : public row_reader {
+private:
+  std::ifstream in_;
+  binary_grid_header header_;
+  coordinate rows_left_;
+  std::vector<grid_word> padding_;
+
+public:
+
+  explicit binary_row_reader(const std::string& filename)
+  : in_(filename, std::ios::binary) {
+    if (!in_) {
+      throw std::runtime_error("cannot open " + filename);
+    }
+    if (!in_.read(reinterpret_cast<char*>(&header_), sizeof(header_)) ||
+        std::memcmp(header_.magic, BINARY_GRID_MAGIC, sizeof(BINARY_GRID_MAGIC)) != 0) {
+      throw std::runtime_error(filename + ": not a binary grid file");
+    }
+    if (header_.rows == 0 || header_.columns == 0 ||
+        header_.stride < words_per_row(header_.columns)) {
+      throw std::runtime_error(filename + ": bad binary grid header");
+    }
+    rows_left_ = header_.rows;
+    padding_.resize(header_.stride - words_per_row(header_.columns));
+  }
+
+  coordinate rows() const { return header_.rows; }
+  coordinate columns() const override { return header_.columns; }
+
+  bool read_row(grid_word* row) override {
+    if (rows_left_ == 0) {
+      return false;
+    }
+    coordinate words = words_per_row(header_.columns);
+    in_.read(reinterpret_cast<char*>(row), words * sizeof(grid_word));
+    if (!padding_.empty()) {
+      in_.read(reinterpret_cast<char*>(padding_.data()), padding_.size() * sizeof(grid_word));
+    }
+    if (!in_) {
+      throw std::runtime_error("binary grid file is truncated");
+    }
+    // Keep the bits past the last column clear, whatever the file says.
+    coordinate tail = header_.columns % GRID_WORD_BITS;
+    if (tail != 0) {
+      row[words - 1] &= (grid_word(1) << tail) - 1;
+    }
+    --rows_left_;
+    return true;
+  }
+};
+
+// Reads the run-length encoded format.
+class rle_row_reader : public row_reader {
+private:
+  std::ifstream in_;
+  rle_grid_header header_;
+  coordinate rows_left_;
+
+  std::uint64_t read_varint() {
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      int byte = in_.get();
+      if (byte == EOF) {
+        throw std::runtime_error("run-length grid file is truncated");
+      }
+      value |= std::uint64_t(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return value;
+      }
+    }
+    throw std::runtime_error("run-length grid file has an overlong number");
+  }
+
+public:
+
+  explicit rle_row_reader(const std::string& filename)
+  : in_(filename, std::ios::binary) {
+    if (!in_) {
+      throw std::runtime_error("cannot open " + filename);
+    }
+    if (!in_.read(reinterpret_cast<char*>(&header_), sizeof(header_)) ||
+        std::memcmp(header_.magic, RLE_GRID_MAGIC, sizeof(RLE_GRID_MAGIC)) != 0) {
+      throw std::runtime_error(filename + ": not a run-length grid file");
+    }
+    if (header_.rows == 0 || header_.columns == 0) {
+      throw std::runtime_error(filename + ": bad run-length grid header");
+    }
+    rows_left_ = header_.rows;
+  }
+
+  coordinate rows() const { return header_.rows; }
+  coordinate columns() const override { return header_.columns; }
+
+  bool read_row(grid_word* row) override {
+    if (rows_left_ == 0) {
+      return false;
+    }
+    std::fill(row, row + words_per_row(header_.columns), 0);
+    coordinate c = 0;
+    for (std::uint64_t runs = read_varint(); runs > 0; --runs) {
+      // c never exceeds the width, so a gap checked against the room left
+      // cannot wrap around.
+      std::uint64_t gap = read_varint();
+      if (gap > header_.columns - c) {
+        throw std::runtime_error("run-length grid row is too long");
+      }
+      c += gap;
+      std::uint64_t length = read_varint();
+      if (length > header_.columns || c > header_.columns - length) {
+        throw std::runtime_error("run-length grid row is too long");
+      }
+      set_iceberg_run(row, c, length);
+      c += length;
+    }
+    --rows_left_;
+    return true;
+  }
+};
+
+// Open a grid file of any format, telling them apart by the magic bytes.
+std::unique_ptr<row_reader> open_row_reader(const std::string& filename) {
+  std::ifstream probe(filename, std::ios::binary);
+  if (!probe) {
+    throw std::runtime_error("cannot open " + filename);
+  }
+  char magic[sizeof(BINARY_GRID_MAGIC)] = {};
+  probe.read(magic, sizeof(magic));
+  if (probe && std::memcmp(magic, BINARY_GRID_MAGIC, sizeof(magic)) == 0) {
+    return std::unique_ptr<row_reader>(new binary_row_reader(filename));
+  }
+  if (probe && std::memcmp(magic, RLE_GRID_MAGIC, sizeof(magic)) == 0) {
+    return std::unique_ptr<row_reader>(new rle_row_reader(filename));
+  }
+  return std::unique_ptr<row_reader>(new text_row_reader(filename));
+}
+
+// Destination for bit-packed rows, written from the top of the grid down.
+class row_writer {
+public:
+  virtual ~row_writer() { }
+
+  // Append the next row, given as words_per_row(columns) words.
+  virtual void write_row(const grid_word* row) = 0;
+
+  // Finish the file. At least one row must have been written.
+  virtual void close() = 0;
+};
+
+// Writes the text format one row at a time.
+class text_row_writer : public row_writer {
+private:
+  std::ofstream out_;
+  coordinate columns_;
+  std::string line_;
+
+public:
+
+  text_row_writer(const std::string& filename, coordinate columns)
+  : out_(filename, std::ios::trunc), columns_(columns), line_(columns, '.') {
+    assert(columns > 0);
+    if (!out_) {
+      throw std::runtime_error("cannot create " + filename);
+    }
+  }
+
+  void write_row(const grid_word* row) override {
+    for (coordinate c = 0; c < columns_; ++c) {
+      line_[c] = ((row[c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS)) & 1) ? 'X' : '.';
+    }
+    out_ << line_ << '\n';
+  }
+
+  void close() override {
+    out_.close();
+    if (!out_) {
+      throw std::runtime_error("error writing text grid file");
+    }
+  }
+};
+
+// Writes the binary or run-length format one row at a time, so grids of any
+// height can be produced without holding them in memory. The row count in
+// the header is filled in by close().
+template <typename Header>
+class counted_row_writer : public row_writer {
+protected:
+  std::ofstream out_;
+  Header header_ = {};
+
+  counted_row_writer(const std::string& filename, const char* magic, coordinate columns)
+  : out_(filename, std::ios::binary | std::ios::trunc) {
+    assert(columns > 0);
+    if (!out_) {
+      throw std::runtime_error("cannot create " + filename);
+    }
+    std::memcpy(header_.magic, magic, sizeof(header_.magic));
+    header_.rows = 0;
+    header_.columns = columns;
+    out_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+  }
+
+public:
+
+  void close() override {
+    assert(header_.rows > 0);
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    out_.close();
+    if (!out_) {
+      throw std::runtime_error("error writing grid file");
+    }
+  }
+};
+
+class binary_row_writer : public counted_row_writer<binary_grid_header> {
+public:
+
+  binary_row_writer(const std::string& filename, coordinate columns)
+  : counted_row_writer(filename, BINARY_GRID_MAGIC, columns) {
+    header_.stride = words_per_row(columns);
+  }
+
+  void write_row(const grid_word* row) override {
+    out_.write(reinterpret_cast<const char*>(row), header_.stride * sizeof(grid_word));
+    ++header_.rows;
+  }
+};
+
+class rle_row_writer : public counted_row_writer<rle_grid_header> {
+private:
+  std::vector<std::pair<coordinate, coordinate>> runs_;
+
+  void write_varint(std::uint64_t value) {
+    while (value >= 0x80) {
+      out_.put(char((value & 0x7f) | 0x80));
+      value >>= 7;
+    }
+    out_.put(char(value));
+  }
+
+public:
+
+  rle_row_writer(const std::string& filename, coordinate columns)
+  : counted_row_writer(filename, RLE_GRID_MAGIC, columns) { }
+
+  void write_row(const grid_word* row) override {
+    runs_.clear();
+    for_each_iceberg_run(row, header_.columns, [&](coordinate first, coordinate length) {
+      runs_.emplace_back(first, length);
+    });
+    write_varint(runs_.size());
+    coordinate end = 0;
+    for (auto& run : runs_) {
+      write_varint(run.first - end);
+      write_varint(run.second);
+      end = run.first + run.second;
+    }
+    ++header_.rows;
+  }
+};
+
+// Create a writer for the given file, choosing the format by extension:
+// ".txt" for text, ".rle" for run-length, and binary otherwise.
+std::unique_ptr<row_writer> open_row_writer(const std::string& filename, coordinate columns) {
+  auto has_extension = [&](const std::string& extension) {
+    return filename.size() >= extension.size() &&
+           filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+  };
+  if (has_extension(".txt")) {
+    return std::unique_ptr<row_writer>(new text_row_writer(filename, columns));
+  }
+  if (has_extension(".rle")) {
+    return std::unique_ptr<row_writer>(new rle_row_writer(filename, columns));
+  }
+  return std::unique_ptr<row_writer>(new binary_row_writer(filename, columns));
+}
+
+// Copy every row from reader to writer and close the writer. Returns the
+// number of rows copied. Only one row is held in memory.
+coordinate copy_rows(row_reader& reader, row_writer& writer) {
+  std::vector<grid_word> row(words_per_row(reader.columns()));
+  coordinate rows = 0;
+  while (reader.read_row(row.data())) {
+    writer.write_row(row.data());
+    ++rows;
+  }
+  writer.close();
+  return rows;
+}
+
+// Save a grid in the given writer's format.
+void write_grid(const grid& setting, row_writer& writer) {
+  for (coordinate r = 0; r < setting.rows(); ++r) {
+    writer.write_row(setting.row_words(r));
+  }
+  writer.close();
+}
+
+// Save a grid in the text format.
+void write_text_grid(const grid& setting, const std::string& filename) {
+  text_row_writer writer(filename, setting.columns());
+  write_grid(setting, writer);
+}
+
+// Save a grid in the binary format.
+void write_binary_grid(const grid& setting, const std::string& filename) {
+  binary_row_writer writer(filename, setting.columns());
+  write_grid(setting, writer);
+}
+
+// Save a grid in the run-length format.
+void write_rle_grid(const grid& setting, const std::string& filename) {
+  rle_row_writer writer(filename, setting.columns());
+  write_grid(setting, writer);
+}
+
+// Load a grid file of any format into memory.
+grid load_grid(const std::string& filename) {
+  auto reader = open_row_reader(filename);
+  const coordinate words = words_per_row(reader->columns());
+  std::vector<grid_word> cells;
+  coordinate rows = 0;
+  if (auto* binary = dynamic_cast<binary_row_reader*>(reader.get())) {
+    cells.reserve(binary->rows() * words);
+  } else if (auto* rle = dynamic_cast<rle_row_reader*>(reader.get())) {
+    cells.reserve(rle->rows() * words);
+  }
+  while (true) {
+    cells.resize((rows + 1) * words);
+    if (!reader->read_row(&cells[rows * words])) {
+      break;
+    }
+    ++rows;
+  }
+  cells.resize(rows * words);
+  return grid(rows, reader->columns(), std::move(cells));
+}
+
+// A whole file mapped read-only into memory; unmapped when the last copy
+// of mapping is destroyed. A shared mapping (MAP_SHARED) reads the page
+// cache directly, so every process mapping the file uses the same pages.
+struct mapped_file {
+  std::shared_ptr<const void> mapping;
+  size_t length;
+
+  const char* bytes() const { return static_cast<const char*>(mapping.get()); }
+};
+
+mapped_file map_file(const std::string& filename, bool shared = false) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("cannot open " + filename);
+  }
+  struct stat info;
+  if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    throw std::runtime_error(filename + ": empty or unreadable file");
+  }
+  size_t length = info.st_size;
+  void* address = ::mmap(nullptr, length, PROT_READ, shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (address == MAP_FAILED) {
+    throw std::runtime_error("cannot map " + filename);
+  }
+  std::shared_ptr<const void> mapping(address, [length](const void* p) {
+    ::munmap(const_cast<void*>(p), length);
+  });
+  return mapped_file{std::move(mapping), length};
+}
+
+// Return a view of the binary grid record starting at byte offset of a
+// mapped file, and advance offset past it.
+grid view_binary_record(const mapped_file& file, size_t& offset, const std::string& filename) {
+  binary_grid_header header;
+  if (file.length - offset < sizeof(header)) {
+    throw std::runtime_error(filename + ": not a binary grid file");
+  }
+  std::memcpy(&header, file.bytes() + offset, sizeof(header));
+  if (std::memcmp(header.magic, BINARY_GRID_MAGIC, sizeof(BINARY_GRID_MAGIC)) != 0) {
+    throw std::runtime_error(filename + ": not a binary grid file");
+  }
+  if (header.rows == 0 || header.columns == 0 ||
+      header.stride < words_per_row(header.columns) ||
+      (file.length - offset - sizeof(header)) / sizeof(grid_word) / header.stride < header.rows) {
+    throw std::runtime_error(filename + ": bad binary grid header");
+  }
+  auto* words = reinterpret_cast<const grid_word*>(file.bytes() + offset + sizeof(header));
+  // A view cannot mask the bits past the last column the way
+  // binary_row_reader does, and the solvers count on them being clear, so
+  // a file that sets any is rejected.
+  const coordinate tail = header.columns % GRID_WORD_BITS;
+  if (tail != 0) {
+    const grid_word padding = ~((grid_word(1) << tail) - 1);
+    const grid_word* last = words + words_per_row(header.columns) - 1;
+    for (coordinate r = 0; r < header.rows; ++r, last += header.stride) {
+      if (*last & padding) {
+        throw std::runtime_error(filename + ": bad binary grid");
+      }
+    }
+  }
+  offset += sizeof(header) + header.rows * header.stride * sizeof(grid_word);
+  return grid::view(header.rows, header.columns, header.stride, words, file.mapping);
+}
+
+// Map a binary grid file into memory and return a read-only view of it.
+// No cells are copied: pages are read from the file as they are touched,
+// and the mapping lasts as long as any copy of the returned grid.
+grid map_binary_grid(const std::string& filename) {
+  size_t offset = 0;
+  return view_binary_record(map_file(filename), offset, filename);
+}
+
+// A batch file holds any number of binary grid records back to back, each
+// with its own header, so every grid in it can be viewed in place.
+void write_grid_batch(const std::vector<grid>& grids, const std::string& filename) {
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("cannot create " + filename);
+  }
+  for (auto& setting : grids) {
+    binary_grid_header header;
+    std::memcpy(header.magic, BINARY_GRID_MAGIC, sizeof(BINARY_GRID_MAGIC));
+    header.rows = setting.rows();
+    header.columns = setting.columns();
+    header.stride = words_per_row(setting.columns());
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (coordinate r = 0; r < setting.rows(); ++r) {
+      out.write(reinterpret_cast<const char*>(setting.row_words(r)),
+                header.stride * sizeof(grid_word));
+    }
+  }
+  out.close();
+  if (!out) {
+    throw std::runtime_error("error writing " + filename);
+  }
+}
+
+// Map a batch file and return a view of every grid in it.
+std::vector<grid> map_grid_batch(const std::string& filename) {
+  mapped_file file = map_file(filename);
+  std::vector<grid> result;
+  for (size_t offset = 0; offset < file.length; ) {
+    result.push_back(view_binary_record(file, offset, filename));
+  }
+  return result;
+}
+
+// Measurements from one run of iceberg_avoiding_streaming.
+struct stream_stats {
+  coordinate rows = 0, columns = 0;
+  double seconds = 0;
+
+  // Bytes held by the row buffers and the count row, which is all the
+  // solver allocates; it depends on the number of columns only.
+  size_t buffer_bytes = 0;
+
+  double cells_per_second() const {
+    return (seconds > 0) ? double(rows) * double(columns) / seconds : 0;
+  }
+};
+
+// Rows are read in blocks of about this many bytes.
+const size_t STREAM_BLOCK_BYTES = 1 << 16;
+
+// Solve the iceberg avoiding problem for the grid stored in the given file,
+// in any of the formats above, without loading the grid into memory.
+//
+// Only one row of counts is kept. A reader thread fills one block of rows
+// while the calling thread runs the DP over the other, so reading overlaps
+// with computing. If stats is not null it receives measurements of the run.
+unsigned int iceberg_avoiding_streaming(const std::string& filename,
+                                        stream_stats* stats = nullptr) {
+
+  auto start = std::chrono::steady_clock::now();
+
+  auto reader = open_row_reader(filename);
+  const coordinate columns = reader->columns(),
+                   words = words_per_row(columns),
+                   block_rows = std::max<size_t>(1, STREAM_BLOCK_BYTES / (words * sizeof(grid_word)));
+
+  struct block {
+    std::vector<grid_word> words;
+    coordinate rows = 0;
+    bool full = false, last = false;
+  };
+  block blocks[2];
+  for (auto& b : blocks) {
+    b.words.resize(block_rows * words);
+  }
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::exception_ptr error;
+
+  std::thread producer([&]() {
+    for (int i = 0; ; i ^= 1) {
+      auto& b = blocks[i];
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return !b.full; });
+      }
+      coordinate rows = 0;
+      bool last = false;
+      try {
+        while (rows < block_rows && reader->read_row(&b.words[rows * words])) {
+          ++rows;
+        }
+        last = (rows < block_rows);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = std::current_exception();
+        last = true;
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        b.rows = rows;
+        b.last = last;
+        b.full = true;
+      }
+      changed.notify_all();
+      if (last) {
+        return;
+      }
+    }
+  });
+
+  std::vector<unsigned int> counts(columns, 0);
+  counts[0] = 1;
+  coordinate total_rows = 0;
+  for (int i = 0; ; i ^= 1) {
+    auto& b = blocks[i];
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&]() { return b.full; });
+    }
+    for (coordinate r = 0; r < b.rows; ++r) {
+      advance_count_row(&b.words[r * words], counts.data(), columns);
+    }
+    total_rows += b.rows;
+    bool last = b.last;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      b.full = false;
+    }
+    changed.notify_all();
+    if (last) {
+      break;
+    }
+  }
+  producer.join();
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  if (total_rows == 0) {
+    throw std::runtime_error(filename + ": empty grid");
+  }
+
+  if (stats != nullptr) {
+    stats->rows = total_rows;
+    stats->columns = columns;
+    stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats->buffer_bytes = 2 * block_rows * words * sizeof(grid_word)
+                          + columns * sizeof(unsigned int);
+  }
+  return counts[columns - 1];
+}
+
+}
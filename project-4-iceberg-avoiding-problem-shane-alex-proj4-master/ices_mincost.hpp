@@ -0,0 +1,294 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_mincost.hpp
+//
+// Cheapest paths on grids whose water cells have traversal costs.
+//
+// The cost of a path is the sum of the costs of every cell it visits,
+// including (0, 0) and the bottom-right corner, and icebergs cannot be
+// visited at all. The minimum cost to reach each cell follows the same DP
+// as the path count, with (min, +) in place of (+, *), so it runs with a
+// rolling row, or as a parallel wavefront of tiles.
+//
+// To find the cheapest path itself without a table of the whole grid, we
+// use Hirschberg's divide and conquer: a forward pass over the top half of
+// the grid and a backward pass over the bottom half find the column where
+// a cheapest path crosses the middle, and the two quarters of the grid on
+// either side of that crossing are solved the same way, in parallel. The
+// passes only need rolling rows, so memory is O(rows + columns) per worker,
+// and the total time is about twice that of one DP pass.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+#include "ices_parallel.hpp"
+#include "ices_random.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// Cost of one cell, and of a whole path.
+using cell_cost = std::uint32_t;
+using path_cost = std::uint64_t;
+
+// Cost of a cell or path that cannot be used. Sums of two costs never
+// overflow, and every computed cost is clamped to this value.
+const path_cost PATH_COST_INFINITE = std::numeric_limits<path_cost>::max() / 4;
+
+// A grid with a traversal cost for every cell. Icebergs have a cost too,
+// which is ignored while they are icebergs.
+class weighted_grid {
+private:
+  grid setting_;
+  std::vector<cell_cost> costs_;
+
+public:
+
+  // Create a weighted grid where every cell costs cost.
+  explicit weighted_grid(const grid& setting, cell_cost cost = 1)
+  : setting_(setting), costs_(setting.rows() * setting.columns(), cost) { }
+
+  // Create a weighted grid from row-major costs, one per cell.
+  weighted_grid(const grid& setting, std::vector<cell_cost>&& costs)
+  : setting_(setting), costs_(std::move(costs)) {
+    assert(costs_.size() == setting_.rows() * setting_.columns());
+  }
+
+  // The icebergs. Paths returned for this grid refer to this object, so
+  // the weighted grid must outlive them.
+  const grid& setting() const { return setting_; }
+  grid& setting() { return setting_; }
+
+  coordinate rows() const { return setting_.rows(); }
+  coordinate columns() const { return setting_.columns(); }
+
+  cell_cost cost(coordinate row, coordinate column) const {
+    assert(setting_.is_row_column(row, column));
+    return costs_[row * columns() + column];
+  }
+
+  void set_cost(coordinate row, coordinate column, cell_cost cost) {
+    assert(setting_.is_row_column(row, column));
+    costs_[row * columns() + column] = cost;
+  }
+
+  // The costs of one row.
+  const cell_cost* cost_row(coordinate row) const {
+    assert(setting_.is_row(row));
+    return &costs_[row * columns()];
+  }
+
+  // The cost of visiting a cell: PATH_COST_INFINITE for icebergs.
+  path_cost visit_cost(coordinate row, coordinate column) const {
+    return (setting_.get(row, column) == CELL_ICEBERG) ? PATH_COST_INFINITE
+                                                       : cost(row, column);
+  }
+
+  // The total cost of a path in this grid.
+  path_cost cost_of(const path& p) const {
+    path_cost total = 0;
+    coordinate row = 0, column = 0;
+    for (auto& s : p.steps()) {
+      row += s.delta_row();
+      column += s.delta_column();
+      total += cost(row, column);
+    }
+    return total;
+  }
+};
+
+// Create a random weighted grid: icebergs as in random_grid_density, and
+// costs uniform in [1, max_cost], all from the given seed.
+weighted_grid random_weighted_grid(coordinate rows, coordinate columns, double density,
+                                   cell_cost max_cost, std::uint64_t seed,
+                                   work_stealing_pool& pool = default_pool()) {
+  assert(max_cost > 0);
+  std::vector<cell_cost> costs(rows * columns);
+  pool.parallel_for(rows, [&](size_t r, unsigned) {
+    // Streams past those random_grid_density uses for its rows.
+    counter_rng gen(seed, rows + 1 + r);
+    for (coordinate c = 0; c < columns; ++c) {
+      costs[r * columns + c] = cell_cost(1 + gen.below(max_cost));
+    }
+  }, 64);
+  return weighted_grid(random_grid_density(rows, columns, density, seed, pool),
+                       std::move(costs));
+}
+
+// Advance a row of minimum costs by one grid row, over columns
+// [first, first + width) of that row.
+//
+// On entry costs[k] is the cheapest way to reach column first + k of the
+// row above; on exit it is the cheapest way to reach it in this row.
+// from_left is the cheapest way to reach column first - 1 of this row.
+// Returns the cost of the last column.
+path_cost advance_cost_row(const weighted_grid& setting, coordinate row, coordinate first,
+                           coordinate width, path_cost* costs,
+                           path_cost from_left = PATH_COST_INFINITE) {
+  const grid_word* icebergs = setting.setting().row_words(row);
+  const cell_cost* cell = setting.cost_row(row) + first;
+  auto visit = [&](coordinate k) -> path_cost {
+    coordinate c = first + k;
+    return ((icebergs[c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS)) & 1)
+           ? PATH_COST_INFINITE : cell[k];
+  };
+  // Steps down are independent across columns, so this loop vectorizes;
+  // only the steps right are left for the sequential scan.
+  for (coordinate k = 0; k < width; ++k) {
+    costs[k] = std::min(PATH_COST_INFINITE, costs[k] + visit(k));
+  }
+  for (coordinate k = 0; k < width; ++k) {
+    from_left = std::min(costs[k], std::min(PATH_COST_INFINITE, from_left + visit(k)));
+    costs[k] = from_left;
+  }
+  return from_left;
+}
+
+// The mirror image of advance_cost_row: on entry costs[k] is the cheapest
+// way from column first + k of the row below to the goal, and on exit the
+// cheapest way from this row.
+void retreat_cost_row(const weighted_grid& setting, coordinate row, coordinate first,
+                      coordinate width, path_cost* costs) {
+  const grid_word* icebergs = setting.setting().row_words(row);
+  const cell_cost* cell = setting.cost_row(row) + first;
+  auto visit = [&](coordinate k) -> path_cost {
+    coordinate c = first + k;
+    return ((icebergs[c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS)) & 1)
+           ? PATH_COST_INFINITE : cell[k];
+  };
+  for (coordinate k = 0; k < width; ++k) {
+    costs[k] = std::min(PATH_COST_INFINITE, costs[k] + visit(k));
+  }
+  path_cost from_right = PATH_COST_INFINITE;
+  for (coordinate k = width; k-- > 0; ) {
+    from_right = std::min(costs[k], std::min(PATH_COST_INFINITE, from_right + visit(k)));
+    costs[k] = from_right;
+  }
+}
+
+// The cost of the cheapest valid path, or PATH_COST_INFINITE if there is
+// no valid path.
+path_cost min_path_cost(const weighted_grid& setting) {
+  // A virtual row above the grid that only enters (0, 0), for free.
+  std::vector<path_cost> costs(setting.columns(), PATH_COST_INFINITE);
+  costs[0] = 0;
+  for (coordinate r = 0; r < setting.rows(); ++r) {
+    advance_cost_row(setting, r, 0, setting.columns(), costs.data());
+  }
+  return costs.back();
+}
+
+// min_path_cost, solved in tile x tile tiles spread across the pool as a
+// wavefront. Tiles pass their last row down and last column right through
+// rolling buffers, as in count_move_paths_wavefront.
+path_cost min_path_cost_wavefront(const weighted_grid& setting,
+                                  work_stealing_pool& pool = default_pool(),
+                                  coordinate tile = 256) {
+  assert(tile > 0);
+  const coordinate rows = setting.rows(), columns = setting.columns(),
+                   bands = (rows + tile - 1) / tile, stripes = (columns + tile - 1) / tile;
+  std::vector<path_cost> bottom[3], side(rows);
+  for (auto& buffer : bottom) {
+    buffer.resize(columns);
+  }
+  std::vector<std::vector<path_cost>> scratch(pool.size());
+
+  parallel_wavefront(pool, bands, stripes, [&](coordinate i, coordinate j, unsigned worker) {
+    const coordinate r0 = i * tile, r1 = std::min(rows, r0 + tile),
+                     c0 = j * tile, c1 = std::min(columns, c0 + tile);
+    auto& costs = scratch[worker];
+    if (i > 0) {
+      const auto& above = bottom[(i - 1) % 3];
+      costs.assign(above.begin() + c0, above.begin() + c1);
+    } else {
+      costs.assign(c1 - c0, PATH_COST_INFINITE);
+      if (j == 0) {
+        costs[0] = 0;
+      }
+    }
+    for (coordinate r = r0; r < r1; ++r) {
+      side[r] = advance_cost_row(setting, r, c0, c1 - c0, costs.data(),
+                                 (j > 0) ? side[r] : PATH_COST_INFINITE);
+    }
+    std::copy(costs.begin(), costs.end(), &bottom[i % 3][c0]);
+  });
+  return bottom[(bands - 1) % 3][columns - 1];
+}
+
+// Write the steps of a cheapest path from (r0, c0) to (r1, c1) to out, all
+// within those rows and columns. Both cells must be water and the path
+// must exist.
+void min_cost_steps(const weighted_grid& setting, coordinate r0, coordinate c0,
+                    coordinate r1, coordinate c1, step_direction* out,
+                    work_stealing_pool& pool) {
+  if (r0 == r1) {
+    std::fill(out, out + (c1 - c0), STEP_DIRECTION_RIGHT);
+    return;
+  }
+  const coordinate middle = r0 + (r1 - r0) / 2, width = c1 - c0 + 1;
+  // Splitting only pays for itself on large enough pieces.
+  const bool fork = (r1 - r0) * width >= (1 << 16);
+
+  // Find the column where a cheapest path steps down from the middle row.
+  // The rows are freed before recursing, so only one pair of them is alive
+  // per level in progress.
+  coordinate best = 0;
+  {
+    // forward[k]: cheapest from (r0, c0) to (middle, c0 + k).
+    // backward[k]: cheapest from (middle + 1, c0 + k) to (r1, c1).
+    std::vector<path_cost> forward(width, PATH_COST_INFINITE),
+                           backward(width, PATH_COST_INFINITE);
+    forward[0] = 0;
+    backward[width - 1] = 0;
+    task_group halves(pool);
+    auto run_forward = [&]() {
+      for (coordinate r = r0; r <= middle; ++r) {
+        advance_cost_row(setting, r, c0, width, forward.data());
+      }
+    };
+    if (fork) {
+      halves.run(run_forward);
+    } else {
+      run_forward();
+    }
+    for (coordinate r = r1; r > middle; --r) {
+      retreat_cost_row(setting, r, c0, width, backward.data());
+    }
+    halves.wait();
+
+    for (coordinate k = 1; k < width; ++k) {
+      if (forward[k] + backward[k] < forward[best] + backward[best]) {
+        best = k;
+      }
+    }
+    assert(forward[best] + backward[best] < PATH_COST_INFINITE);
+  }
+
+  const coordinate crossing = c0 + best;
+  step_direction* down = out + (middle - r0) + best;
+  *down = STEP_DIRECTION_DOWN;
+  task_group quarters(pool);
+  if (fork) {
+    quarters.run([&]() {
+      min_cost_steps(setting, r0, c0, middle, crossing, out, pool);
+    });
+  } else {
+    min_cost_steps(setting, r0, c0, middle, crossing, out, pool);
+  }
+  min_cost_steps(setting, middle + 1, crossing, r1, c1, down + 1, pool);
+  quarters.wait();
+}
+
+// Return a cheapest valid path, which must exist. The path refers to
+// setting.setting(). Memory is O(rows + columns) per worker.
+path min_cost_path(const weighted_grid& setting, work_stealing_pool& pool = default_pool()) {
+  const coordinate rows = setting.rows(), columns = setting.columns();
+  std::vector<step_direction> steps(rows + columns - 2);
+  min_cost_steps(setting, 0, 0, rows - 1, columns - 1, steps.data(), pool);
+  return path(setting.setting(), steps);
+}
+
+}
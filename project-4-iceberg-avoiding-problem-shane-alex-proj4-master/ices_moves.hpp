@@ -0,0 +1,404 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_moves.hpp
+//
+// Path counting with other sets of moves than RIGHT and DOWN.
+//
+// A move set is a type with a static constexpr array MOVES of grid_move
+// values, such as right_down_moves below. Every move must go to a later
+// cell in row-major order, either down some rows or right within a row, so
+// paths can never loop and the grid is a DAG. A move may jump over cells;
+// only the cell it lands on must be water. Moves may also be restricted per
+// cell with a move_masks object.
+//
+// The counting kernels take the move set as a template parameter, so the
+// sum over moves is unrolled and specialized at compile time for each set.
+// Like iceberg_avoiding_dyn_prog, counts are modulo 2^32.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "ices_algs.hpp"
+#include "ices_parallel.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// One move: from (row, column) to (row + rows, column + columns).
+struct grid_move {
+  int rows, columns;
+};
+
+// The moves of the original problem, in step_direction order.
+struct right_down_moves {
+  static constexpr grid_move MOVES[] = {{0, 1}, {1, 0}};
+};
+
+// RIGHT, DOWN, and diagonally down and to the right.
+struct diagonal_moves {
+  static constexpr grid_move MOVES[] = {{0, 1}, {1, 0}, {1, 1}};
+};
+
+// RIGHT, DOWN, and the two knight jumps that go down and to the right.
+struct knight_moves {
+  static constexpr grid_move MOVES[] = {{0, 1}, {1, 0}, {1, 2}, {2, 1}};
+};
+
+// RIGHT, DOWN, and down and to the left, which is still acyclic.
+struct down_left_moves {
+  static constexpr grid_move MOVES[] = {{0, 1}, {1, 0}, {1, -1}};
+};
+
+template <typename Moves>
+constexpr size_t move_count() {
+  return sizeof(Moves::MOVES) / sizeof(grid_move);
+}
+
+// How far the moves of a set reach: at most down rows down, right columns
+// to the right and left columns to the left.
+struct move_reach {
+  coordinate down, right, left;
+  bool acyclic;
+};
+
+template <typename Moves>
+constexpr move_reach reach_of() {
+  move_reach result = {0, 0, 0, true};
+  for (size_t k = 0; k < move_count<Moves>(); ++k) {
+    const grid_move m = Moves::MOVES[k];
+    result.acyclic = result.acyclic && (m.rows > 0 || (m.rows == 0 && m.columns > 0));
+    result.down = std::max<coordinate>(result.down, std::max(m.rows, 0));
+    result.right = std::max<coordinate>(result.right, std::max(m.columns, 0));
+    result.left = std::max<coordinate>(result.left, std::max(-m.columns, 0));
+  }
+  return result;
+}
+
+// Call f(std::integral_constant<size_t, k>()) for every move index k, so f
+// can use the move as a compile-time constant.
+template <typename F, size_t... K>
+inline void for_each_move_index(F&& f, std::index_sequence<K...>) {
+  (f(std::integral_constant<size_t, K>()), ...);
+}
+
+template <typename Moves, typename F>
+inline void for_each_move(F&& f) {
+  for_each_move_index(f, std::make_index_sequence<move_count<Moves>()>());
+}
+
+// Allows every move from every cell.
+struct all_moves {
+  bool allows(coordinate, coordinate, size_t) const { return true; }
+};
+
+// Allows or forbids each move separately from each cell of a grid. Bit k of
+// a cell's mask is set when move k may be taken from it, for up to 8 moves.
+class move_masks {
+private:
+  coordinate columns_;
+  std::vector<std::uint8_t> masks_;
+
+public:
+
+  // Start with every move allowed from every cell.
+  move_masks(coordinate rows, coordinate columns)
+  : columns_(columns), masks_(rows * columns, 0xff) { }
+
+  bool allows(coordinate row, coordinate column, size_t k) const {
+    return (masks_[row * columns_ + column] >> k) & 1;
+  }
+
+  std::uint8_t mask(coordinate row, coordinate column) const {
+    return masks_[row * columns_ + column];
+  }
+
+  void set_mask(coordinate row, coordinate column, std::uint8_t mask) {
+    masks_[row * columns_ + column] = mask;
+  }
+};
+
+// A path made of the moves of a move set, the counterpart of path.
+// moves() holds the index into Moves::MOVES of each move after the start.
+template <typename Moves>
+class move_path {
+private:
+  const grid* setting_;
+  std::vector<unsigned> moves_;
+  coordinate final_row_, final_column_;
+
+public:
+
+  // Create an empty path at (0, 0).
+  explicit move_path(const grid& setting)
+  : setting_(&setting), final_row_(0), final_column_(0) { }
+
+  // Create a path from (0, 0) taking the given moves, which must be valid.
+  move_path(const grid& setting, const std::vector<unsigned>& moves_after_start)
+  : move_path(setting) {
+    for (auto k : moves_after_start) {
+      add_step(k);
+    }
+  }
+
+  const grid& setting() const { return *setting_; }
+  const std::vector<unsigned>& moves() const { return moves_; }
+  coordinate final_row() const { return final_row_; }
+  coordinate final_column() const { return final_column_; }
+
+  // Return the row/column we would be in after taking move k. Moves off
+  // the left edge wrap around to huge column numbers, outside the grid.
+  coordinate row_after(unsigned k) const { return final_row_ + Moves::MOVES[k].rows; }
+  coordinate column_after(unsigned k) const { return final_column_ + Moves::MOVES[k].columns; }
+
+  // Return true if move k lands inside the grid on a CELL_WATER cell, and
+  // masks allow it from the current cell.
+  template <typename Masks = all_moves>
+  bool is_step_valid(unsigned k, const Masks& masks = Masks()) const {
+    return k < move_count<Moves>() &&
+           setting_->may_step(row_after(k), column_after(k)) &&
+           masks.allows(final_row_, final_column_, k);
+  }
+
+  // Take move k, which must be valid.
+  void add_step(unsigned k) {
+    assert(is_step_valid(k));
+    coordinate row = row_after(k), column = column_after(k);
+    moves_.push_back(k);
+    final_row_ = row;
+    final_column_ = column;
+  }
+
+  bool operator==(const move_path& o) const { return moves_ == o.moves_; }
+};
+
+// Convert a path of RIGHT and DOWN steps to the equivalent move_path.
+move_path<right_down_moves> to_move_path(const path& p) {
+  move_path<right_down_moves> result(p.setting());
+  for (size_t i = 1; i < p.steps().size(); ++i) {
+    result.add_step((p.steps()[i].direction() == STEP_DIRECTION_RIGHT) ? 0 : 1);
+  }
+  return result;
+}
+
+// Count the paths with the given moves from (row, column) to the
+// bottom-right corner by trying every one.
+template <typename Moves, typename Masks = all_moves>
+unsigned int count_move_paths_from(const grid& setting, coordinate row, coordinate column,
+                                   const Masks& masks = Masks()) {
+  if (row == setting.rows() - 1 && column == setting.columns() - 1) {
+    return 1;
+  }
+  unsigned int total = 0;
+  for (size_t k = 0; k < move_count<Moves>(); ++k) {
+    coordinate r = row + Moves::MOVES[k].rows, c = column + Moves::MOVES[k].columns;
+    if (setting.may_step(r, c) && masks.allows(row, column, k)) {
+      total += count_move_paths_from<Moves>(setting, r, c, masks);
+    }
+  }
+  return total;
+}
+
+// Count the paths with the given moves by exhaustive search. Only for
+// small grids.
+template <typename Moves, typename Masks = all_moves>
+unsigned int count_move_paths_exhaustive(const grid& setting, const Masks& masks = Masks()) {
+  static_assert(reach_of<Moves>().acyclic, "moves must go down or right");
+  return count_move_paths_from<Moves>(setting, 0, 0, masks);
+}
+
+// Compute counts for grid row r, columns [first, first + width).
+//
+// rows[d][j] is the count at row r - d, column first + j, for d up to
+// the move set's reach; rows[0] receives the results. Entries for columns
+// outside the grid, up to the reach on either side, must be 0.
+template <typename Moves, typename Masks>
+inline void advance_move_row(const grid_word* icebergs, coordinate r, coordinate first,
+                             coordinate width, unsigned int* const* rows, const Masks& masks) {
+  unsigned int* here = rows[0];
+  coordinate j = 0;
+  if (r == 0 && first == 0) {
+    here[0] = 1;
+    j = 1;
+  }
+  if constexpr (std::is_same<Moves, right_down_moves>::value &&
+                std::is_same<Masks, all_moves>::value) {
+    // The running sum of advance_count_range, reading from the row above.
+    unsigned int from_left = here[std::ptrdiff_t(j) - 1];
+    for (; j < width; ++j) {
+      const coordinate c = first + j;
+      unsigned int water = unsigned(((icebergs[c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS)) & 1) ^ 1);
+      from_left = (rows[1][j] + from_left) & (0u - water);
+      here[j] = from_left;
+    }
+    return;
+  }
+  for (; j < width; ++j) {
+    const coordinate c = first + j;
+    if ((icebergs[c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS)) & 1) {
+      here[j] = 0;
+      continue;
+    }
+    unsigned int sum = 0;
+    for_each_move<Moves>([&](auto k) {
+      constexpr grid_move m = Moves::MOVES[decltype(k)::value];
+      unsigned int from = rows[m.rows][std::ptrdiff_t(j) - m.columns];
+      if constexpr (std::is_same<Masks, all_moves>::value) {
+        sum += from;
+      } else if (from != 0 && masks.allows(r - m.rows, c - m.columns, decltype(k)::value)) {
+        sum += from;
+      }
+    });
+    here[j] = sum;
+  }
+}
+
+// Count the paths with the given moves, modulo 2^32, keeping only as many
+// rolling rows as the moves reach down. For right_down_moves with no masks
+// this is the same kernel as iceberg_avoiding_rolling.
+template <typename Moves, typename Masks = all_moves>
+unsigned int count_move_paths(const grid& setting, const Masks& masks = Masks()) {
+  constexpr move_reach reach = reach_of<Moves>();
+  static_assert(reach.acyclic, "moves must go down or right");
+
+  const coordinate rows = setting.rows(), columns = setting.columns();
+  assert(rows > 0);
+  assert(columns > 0);
+
+  if constexpr (std::is_same<Moves, right_down_moves>::value &&
+                std::is_same<Masks, all_moves>::value) {
+    std::vector<unsigned int> counts(columns, 0);
+    counts[0] = 1;
+    for (coordinate r = 0; r < rows; ++r) {
+      advance_count_row(setting.row_words(r), counts.data(), columns);
+    }
+    return counts.back();
+  } else {
+    // A ring of depth rows, each padded with zeros on both sides.
+    constexpr coordinate depth = reach.down + 1;
+    const coordinate width = reach.right + columns + reach.left;
+    std::vector<unsigned int> ring(depth * width, 0);
+    std::array<unsigned int*, depth> window;
+    for (coordinate r = 0; r < rows; ++r) {
+      for (coordinate d = 0; d < depth; ++d) {
+        window[d] = &ring[((r + depth - d) % depth) * width + reach.right];
+      }
+      advance_move_row<Moves>(setting.row_words(r), r, 0, columns, window.data(), masks);
+    }
+    return ring[((rows - 1) % depth) * width + reach.right + columns - 1];
+  }
+}
+
+// Count the paths with the given moves, modulo 2^32, in tiles of about
+// tile x tile cells spread across the pool as a wavefront: the tiles of
+// each anti-diagonal only depend on earlier anti-diagonals, so they are
+// solved in parallel. Moves may not go left.
+//
+// Memory stays proportional to rows + columns: tiles pass their last few
+// rows down through one of three full-width buffers, chosen by tile row so
+// no buffer is written while a tile of a later anti-diagonal still needs
+// it, and their last few columns right through a buffer with one entry per
+// grid row.
+template <typename Moves, typename Masks>
+unsigned int count_move_paths_wavefront(const grid& setting, const Masks& masks,
+                                        work_stealing_pool& pool = default_pool(),
+                                        coordinate tile = 256) {
+  constexpr move_reach reach = reach_of<Moves>();
+  static_assert(reach.acyclic, "moves must go down or right");
+  static_assert(reach.left == 0, "wavefront moves may not go left");
+  constexpr coordinate depth = reach.down + 1;
+
+  const coordinate rows = setting.rows(), columns = setting.columns();
+  assert(rows > 0);
+  assert(columns > 0);
+  assert(tile > 0);
+
+  const coordinate tile_rows = std::max(tile, reach.down),
+                   tile_columns = std::max(tile, reach.right),
+                   bands = (rows + tile_rows - 1) / tile_rows,
+                   stripes = (columns + tile_columns - 1) / tile_columns,
+                   local_width = reach.right + tile_columns;
+
+  std::vector<unsigned int> bottom[3], side(rows * reach.right, 0);
+  for (auto& buffer : bottom) {
+    buffer.assign(reach.down * columns, 0);
+  }
+  std::vector<std::vector<unsigned int>> scratch(pool.size());
+  unsigned int result = 0;
+
+  auto solve_tile = [&](coordinate i, coordinate j, unsigned worker) {
+    const coordinate r0 = i * tile_rows, r1 = std::min(rows, r0 + tile_rows),
+                     c0 = j * tile_columns, c1 = std::min(columns, c0 + tile_columns);
+    auto& local = scratch[worker];
+    local.resize((reach.down + tile_rows) * local_width);
+
+    // Local row reach.down + k is grid row r0 + k, and local column
+    // reach.right + k is grid column c0 + k; the rest is the halo, which
+    // is 0 outside the grid. Cells inside the tile are all overwritten.
+    for (coordinate d = 0; d < reach.down; ++d) {
+      unsigned int* halo = &local[d * local_width];
+      std::fill(halo, halo + local_width, 0);
+      if (i > 0) {
+        const auto& above = bottom[(i - 1) % 3];
+        coordinate from = (c0 >= reach.right) ? c0 - reach.right : 0;
+        std::copy(above.data() + d * columns + from, above.data() + d * columns + c1,
+                  halo + reach.right - (c0 - from));
+      }
+    }
+    for (coordinate r = r0; r < r1; ++r) {
+      unsigned int* halo = &local[(reach.down + r - r0) * local_width];
+      if (j > 0) {
+        std::copy(side.data() + r * reach.right, side.data() + (r + 1) * reach.right, halo);
+      } else {
+        std::fill(halo, halo + reach.right, 0);
+      }
+    }
+
+    std::array<unsigned int*, depth> window;
+    for (coordinate r = r0; r < r1; ++r) {
+      for (coordinate d = 0; d < depth; ++d) {
+        window[d] = &local[(reach.down + r - r0 - d) * local_width + reach.right];
+      }
+      advance_move_row<Moves>(setting.row_words(r), r, c0, c1 - c0, window.data(), masks);
+    }
+
+    // Pass the last rows down and the last columns right.
+    auto& below = bottom[i % 3];
+    for (coordinate d = 0; d < reach.down; ++d) {
+      const unsigned int* last = local.data() + (r1 - r0 + d) * local_width + reach.right;
+      std::copy(last, last + (c1 - c0), below.data() + d * columns + c0);
+    }
+    if (reach.right > 0) {
+      for (coordinate r = r0; r < r1; ++r) {
+        const unsigned int* end = local.data() + (reach.down + r - r0) * local_width
+                                  + reach.right + (c1 - c0);
+        std::copy(end - reach.right, end, &side[r * reach.right]);
+      }
+    }
+    if (r1 == rows && c1 == columns) {
+      result = local[(reach.down + r1 - r0 - 1) * local_width + reach.right + (c1 - c0) - 1];
+    }
+  };
+
+  parallel_wavefront(pool, bands, stripes, solve_tile);
+  return result;
+}
+
+// Solve the iceberg avoiding problem with a rolling row of counts.
+unsigned int iceberg_avoiding_rolling(const grid& setting) {
+  return count_move_paths<right_down_moves>(setting);
+}
+
+// Solve the iceberg avoiding problem with a parallel wavefront of tiles.
+unsigned int iceberg_avoiding_wavefront(const grid& setting,
+                                        work_stealing_pool& pool = default_pool(),
+                                        coordinate tile = 256) {
+  return count_move_paths_wavefront<right_down_moves>(setting, all_moves(), pool, tile);
+}
+
+}
@@ -0,0 +1,151 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_oblivious.hpp
+//
+// A cache-oblivious path-count DP.
+//
+// The row-major DP reads and writes the whole count row for every grid
+// row, so once a row no longer fits in cache every grid row streams it from
+// memory. Here the grid is instead split recursively into quadrants. A
+// rectangle only needs the counts entering it along its top edge and its
+// left edge, and produces the counts leaving along its bottom and right
+// edges. Recursing until rectangles are tiny means that at some depth the
+// rectangles' edges fit in each level of cache, whatever its size, so every
+// level is used well without tuning.
+//
+// The edge counts live in two arrays, one entry per grid column and one per
+// grid row, and every rectangle updates its slices of them in place. Of the
+// four quadrants, the top-right and bottom-left ones use disjoint slices
+// and do not depend on each other, so they run as parallel tasks.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ices_algs.hpp"
+#include "ices_parallel.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// Rectangles of at most this many cells are solved directly, four rows at
+// a time; their edges are a few kilobytes, well inside L1.
+const coordinate OBLIVIOUS_BASE_CELLS = 1 << 14;
+
+// Rectangles of at least this many cells fork their independent quadrants.
+const coordinate OBLIVIOUS_FORK_CELLS = 1 << 18;
+
+// Advance four rows at once through columns [c0, c0 + width), with the
+// same meaning of top and left as oblivious_rectangle. Row k runs k
+// columns behind row k - 1, so it always finds the counts it needs from
+// above, and the four running sums are independent chains that the
+// processor overlaps, instead of one chain that waits on every add.
+void advance_count_four_rows(const grid& setting, coordinate r0, coordinate c0,
+                             coordinate width, unsigned int* __restrict top,
+                             unsigned int* __restrict left) {
+  const grid_word *ice0 = setting.row_words(r0), *ice1 = setting.row_words(r0 + 1),
+                  *ice2 = setting.row_words(r0 + 2), *ice3 = setting.row_words(r0 + 3);
+  unsigned int sum0 = left[r0], sum1 = left[r0 + 1], sum2 = left[r0 + 2], sum3 = left[r0 + 3];
+  auto water = [](const grid_word* row, coordinate c) {
+    return 0u - unsigned(((row[c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS)) & 1) ^ 1);
+  };
+  auto step = [&](unsigned int& sum, const grid_word* row, coordinate c) {
+    sum = (top[c] + sum) & water(row, c);
+    top[c] = sum;
+  };
+  const coordinate end = c0 + width;
+  // Start the staircase, run all four rows, then finish it.
+  for (coordinate c = c0; c < std::min(end, c0 + 3); ++c) {
+    step(sum0, ice0, c);
+    if (c >= c0 + 1) step(sum1, ice1, c - 1);
+    if (c >= c0 + 2) step(sum2, ice2, c - 2);
+  }
+  for (coordinate c = c0 + 3; c < end; ++c) {
+    step(sum0, ice0, c);
+    step(sum1, ice1, c - 1);
+    step(sum2, ice2, c - 2);
+    step(sum3, ice3, c - 3);
+  }
+  // Rows 1 to 3 still owe their last 1 to 3 columns, fewer when the block
+  // is narrower than the staircase.
+  for (coordinate c = end; c < end + 3; ++c) {
+    if (c - 1 < end && c >= c0 + 1) step(sum1, ice1, c - 1);
+    if (c - 2 < end && c >= c0 + 2) step(sum2, ice2, c - 2);
+    if (c - 3 < end && c >= c0 + 3) step(sum3, ice3, c - 3);
+  }
+  left[r0] = sum0;
+  left[r0 + 1] = sum1;
+  left[r0 + 2] = sum2;
+  left[r0 + 3] = sum3;
+}
+
+// Solve rows [r0, r0 + height) and columns [c0, c0 + width).
+//
+// On entry top[c] is the count entering column c from above and left[r]
+// the count entering row r from the left; on exit they are the counts
+// leaving the rectangle's bottom and right edges.
+void oblivious_rectangle(const grid& setting, coordinate r0, coordinate c0,
+                         coordinate height, coordinate width,
+                         unsigned int* top, unsigned int* left,
+                         work_stealing_pool& pool) {
+  if (height * width <= OBLIVIOUS_BASE_CELLS) {
+    coordinate r = r0;
+    for (; r + 4 <= r0 + height; r += 4) {
+      advance_count_four_rows(setting, r, c0, width, top, left);
+    }
+    for (; r < r0 + height; ++r) {
+      left[r] = advance_count_range(setting.row_words(r), top, c0, c0 + width, left[r]);
+    }
+    return;
+  }
+
+  // Keep the pieces roughly square by cutting only the long side of a
+  // thin rectangle.
+  if (width > 2 * height) {
+    coordinate half = width / 2;
+    oblivious_rectangle(setting, r0, c0, height, half, top, left, pool);
+    oblivious_rectangle(setting, r0, c0 + half, height, width - half, top, left, pool);
+    return;
+  }
+  if (height > 2 * width) {
+    coordinate half = height / 2;
+    oblivious_rectangle(setting, r0, c0, half, width, top, left, pool);
+    oblivious_rectangle(setting, r0 + half, c0, height - half, width, top, left, pool);
+    return;
+  }
+
+  const coordinate upper = height / 2, lower = height - upper,
+                   front = width / 2, back = width - front;
+  oblivious_rectangle(setting, r0, c0, upper, front, top, left, pool);
+  if (height * width >= OBLIVIOUS_FORK_CELLS) {
+    task_group corners(pool);
+    corners.run([&]() {
+      oblivious_rectangle(setting, r0, c0 + front, upper, back, top, left, pool);
+    });
+    oblivious_rectangle(setting, r0 + upper, c0, lower, front, top, left, pool);
+    corners.wait();
+  } else {
+    oblivious_rectangle(setting, r0, c0 + front, upper, back, top, left, pool);
+    oblivious_rectangle(setting, r0 + upper, c0, lower, front, top, left, pool);
+  }
+  oblivious_rectangle(setting, r0 + upper, c0 + front, lower, back, top, left, pool);
+}
+
+// Solve the iceberg avoiding problem for the given grid with the
+// cache-oblivious recursion. Memory is one count per row and per column.
+//
+// The grid must be non-empty.
+unsigned int iceberg_avoiding_oblivious(const grid& setting,
+                                        work_stealing_pool& pool = default_pool()) {
+
+  // grid must be non-empty.
+  assert(setting.rows() > 0);
+  assert(setting.columns() > 0);
+
+  std::vector<unsigned int> top(setting.columns(), 0), left(setting.rows(), 0);
+  top[0] = 1;
+  oblivious_rectangle(setting, 0, 0, setting.rows(), setting.columns(),
+                      top.data(), left.data(), pool);
+  return top.back();
+}
+
+}
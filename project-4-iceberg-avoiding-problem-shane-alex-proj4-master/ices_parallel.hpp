@@ -0,0 +1,252 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_parallel.hpp
+//
+// A small work-stealing thread pool used by the parallel algorithms.
+//
+// Each worker owns a deque of tasks. A worker pushes and pops tasks at the
+// back of its own deque, and when that deque is empty it steals from the
+// front of another worker's deque. The thread that calls parallel_for or
+// task_group::wait participates as worker 0, so a pool with one thread
+// simply runs everything on the caller.
+//
+// A pool is meant to be driven by one external thread at a time; tasks may
+// freely create nested task groups.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ices {
+
+class work_stealing_pool {
+private:
+  struct worker_queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::unique_ptr<worker_queue>> queues_;
+  std::vector<std::thread> threads_;
+
+  // Number of tasks sitting in any queue; idle workers sleep while it is 0.
+  std::atomic<size_t> queued_;
+  std::atomic<bool> stopping_;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+
+  // The worker index of the current thread within the pool that owns it,
+  // or 0 for any thread that is not one of this pool's workers.
+  static unsigned& current_index() {
+    thread_local unsigned index = 0;
+    return index;
+  }
+  static const work_stealing_pool*& current_pool() {
+    thread_local const work_stealing_pool* pool = nullptr;
+    return pool;
+  }
+
+  void worker_loop(unsigned index) {
+    current_pool() = this;
+    current_index() = index;
+    while (true) {
+      if (run_one()) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      wake_.wait(lock, [&]() { return stopping_ || queued_ > 0; });
+      if (stopping_ && queued_ == 0) {
+        return;
+      }
+    }
+  }
+
+  bool pop_local(unsigned index, std::function<void()>& task) {
+    auto& queue = *queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+      return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    --queued_;
+    return true;
+  }
+
+  bool steal(unsigned thief, std::function<void()>& task) {
+    for (unsigned k = 1; k < size(); ++k) {
+      auto& queue = *queues_[(thief + k) % size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty()) {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        --queued_;
+        return true;
+      }
+    }
+    return false;
+  }
+
+public:
+
+  // Create a pool with the given total number of workers, including the
+  // calling thread. 0 means one worker per hardware thread.
+  explicit work_stealing_pool(unsigned workers = 0)
+  : queued_(0), stopping_(false) {
+    if (workers == 0) {
+      workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < workers; ++i) {
+      queues_.emplace_back(new worker_queue);
+    }
+    for (unsigned i = 1; i < workers; ++i) {
+      threads_.emplace_back(&work_stealing_pool::worker_loop, this, i);
+    }
+  }
+
+  work_stealing_pool(const work_stealing_pool&) = delete;
+  work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+  ~work_stealing_pool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  // Total number of workers, including the calling thread.
+  unsigned size() const { return queues_.size(); }
+
+  // Index of the calling thread in [0, size()).
+  unsigned worker_index() const {
+    return (current_pool() == this) ? current_index() : 0;
+  }
+
+  // Queue a task on the calling worker's deque.
+  void submit(std::function<void()> task) {
+    auto& queue = *queues_[worker_index()];
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.tasks.push_back(std::move(task));
+      ++queued_;
+    }
+    if (!threads_.empty()) {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      wake_.notify_one();
+    }
+  }
+
+  // Run one queued task, preferring the calling worker's own deque and
+  // stealing otherwise. Return false if no task was found.
+  bool run_one() {
+    std::function<void()> task;
+    unsigned index = worker_index();
+    if (pop_local(index, task) || steal(index, task)) {
+      task();
+      return true;
+    }
+    return false;
+  }
+
+  // Call body(i, worker) for every i in [0, count), where worker is the
+  // index of the thread running that iteration. The range is split
+  // recursively into tasks of at most grain iterations. Returns when every
+  // iteration has finished.
+  template <typename Body>
+  void parallel_for(size_t count, Body&& body, size_t grain = 1);
+};
+
+// A set of tasks that can be waited on together. wait() keeps the waiting
+// thread busy running queued tasks, so nested groups do not deadlock.
+class task_group {
+private:
+  work_stealing_pool& pool_;
+  std::atomic<size_t> outstanding_;
+
+public:
+
+  explicit task_group(work_stealing_pool& pool)
+  : pool_(pool), outstanding_(0) { }
+
+  ~task_group() { wait(); }
+
+  // Queue one task in this group.
+  template <typename Task>
+  void run(Task&& task) {
+    ++outstanding_;
+    pool_.submit([this, task = std::forward<Task>(task)]() mutable {
+      task();
+      --outstanding_;
+    });
+  }
+
+  // Block until every task in this group has finished.
+  void wait() {
+    while (outstanding_ > 0) {
+      if (!pool_.run_one()) {
+        std::this_thread::yield();
+      }
+    }
+  }
+};
+
+template <typename Body>
+void work_stealing_pool::parallel_for(size_t count, Body&& body, size_t grain) {
+  assert(grain > 0);
+  if (count == 0) {
+    return;
+  }
+  task_group group(*this);
+  std::function<void(size_t, size_t)> split = [&](size_t begin, size_t end) {
+    // Hand the upper half to the deque so idle workers can steal it, and
+    // keep splitting the lower half here.
+    while (end - begin > grain) {
+      size_t middle = begin + (end - begin) / 2;
+      group.run([&split, middle, end]() { split(middle, end); });
+      end = middle;
+    }
+    unsigned worker = worker_index();
+    for (size_t i = begin; i < end; ++i) {
+      body(i, worker);
+    }
+  };
+  split(0, count);
+  group.wait();
+}
+
+// Call body(i, j, worker) for every tile (i, j) of a bands x stripes array
+// of tiles, where each tile may depend on the tiles above it and to its
+// left. The tiles of one anti-diagonal run in parallel, and anti-diagonals
+// run one after another.
+template <typename Body>
+void parallel_wavefront(work_stealing_pool& pool, size_t bands, size_t stripes, Body&& body) {
+  for (size_t wave = 0; wave + 1 < bands + stripes; ++wave) {
+    const size_t first = (wave >= stripes) ? wave - stripes + 1 : 0,
+                 end = std::min(bands, wave + 1);
+    pool.parallel_for(end - first, [&](size_t k, unsigned worker) {
+      body(first + k, wave - first - k, worker);
+    });
+  }
+}
+
+// A process-wide pool with one worker per hardware thread.
+inline work_stealing_pool& default_pool() {
+  static work_stealing_pool pool;
+  return pool;
+}
+
+}
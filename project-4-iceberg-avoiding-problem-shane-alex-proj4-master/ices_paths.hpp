@@ -0,0 +1,466 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_paths.hpp
+//
+// Listing individual valid paths, rather than just counting them.
+//
+// Paths are ordered lexicographically by their steps, with
+// STEP_DIRECTION_RIGHT ordered before STEP_DIRECTION_DOWN as in the
+// step_direction enum. A table of suffix counts, the number of valid paths
+// from each cell to the bottom-right corner, lets us find the k-th path
+// directly, and list paths one after another without ever visiting a dead
+// end. The same idea, with approximate counts, lets us draw uniformly random
+// paths from grids of any size.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "ices_parallel.hpp"
+#include "ices_random.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// Type for an exact path count. Counts too large to represent saturate at
+// PATH_COUNT_MAX rather than wrapping.
+using path_count = std::uint64_t;
+const path_count PATH_COUNT_MAX = std::numeric_limits<path_count>::max();
+
+inline path_count saturating_add(path_count a, path_count b) {
+  path_count sum = a + b;
+  return (sum < a) ? PATH_COUNT_MAX : sum;
+}
+
+// The number of valid paths from every cell of a grid to its bottom-right
+// corner. Building the table takes O(rows * columns) time and space.
+class suffix_counts {
+private:
+  const grid* setting_;
+  std::vector<path_count> counts_;
+
+public:
+
+  explicit suffix_counts(const grid& setting)
+  : setting_(&setting), counts_(setting.rows() * setting.columns(), 0) {
+    const coordinate rows = setting.rows(), columns = setting.columns();
+    for (coordinate r = rows; r-- > 0; ) {
+      for (coordinate c = columns; c-- > 0; ) {
+        if (setting.get(r, c) == CELL_ICEBERG) {
+          continue;
+        }
+        if (r == rows - 1 && c == columns - 1) {
+          counts_[r * columns + c] = 1;
+        } else {
+          counts_[r * columns + c] = saturating_add(at(r, c + 1), at(r + 1, c));
+        }
+      }
+    }
+  }
+
+  const grid& setting() const { return *setting_; }
+
+  // The number of valid paths from (row, column) to the bottom-right
+  // corner; 0 for icebergs and for cells outside the grid.
+  path_count at(coordinate row, coordinate column) const {
+    return setting_->is_row_column(row, column)
+           ? counts_[row * setting_->columns() + column] : 0;
+  }
+
+  // The number of valid paths through the whole grid.
+  path_count total() const { return at(0, 0); }
+
+  // The number of valid paths from (row, column) whose next step is dir.
+  path_count after(coordinate row, coordinate column, step_direction dir) const {
+    return (dir == STEP_DIRECTION_RIGHT) ? at(row, column + 1) : at(row + 1, column);
+  }
+};
+
+// Return the steps, after the start, of the valid path with the given rank
+// in lexicographic order. rank must be less than counts.total(). Takes
+// O(rows + columns) time.
+std::vector<step_direction> unrank_steps(const suffix_counts& counts, path_count rank) {
+  const grid& setting = counts.setting();
+  assert(rank < counts.total());
+
+  std::vector<step_direction> steps;
+  steps.reserve(setting.rows() + setting.columns() - 2);
+  coordinate row = 0, column = 0;
+  while (!(row == setting.rows() - 1 && column == setting.columns() - 1)) {
+    // If the right count saturated it is larger than any rank, so going
+    // right is still the correct choice.
+    path_count right = counts.after(row, column, STEP_DIRECTION_RIGHT);
+    if (rank < right) {
+      steps.push_back(STEP_DIRECTION_RIGHT);
+      ++column;
+    } else {
+      rank -= right;
+      steps.push_back(STEP_DIRECTION_DOWN);
+      ++row;
+    }
+  }
+  return steps;
+}
+
+// Return the rank in lexicographic order of the valid path with the given
+// steps after the start. Inverse of unrank_steps.
+path_count rank_steps(const suffix_counts& counts, const std::vector<step_direction>& steps) {
+  path_count rank = 0;
+  coordinate row = 0, column = 0;
+  for (auto dir : steps) {
+    if (dir == STEP_DIRECTION_RIGHT) {
+      ++column;
+    } else {
+      rank = saturating_add(rank, counts.after(row, column, STEP_DIRECTION_RIGHT));
+      ++row;
+    }
+  }
+  return rank;
+}
+
+// Return the valid path with the given rank in lexicographic order.
+path unrank_path(const suffix_counts& counts, path_count rank) {
+  return path(counts.setting(), unrank_steps(counts, rank));
+}
+
+// Lists valid paths in lexicographic order, one at a time, starting from a
+// given rank. Moving to the next path takes amortized O(rows + columns)
+// time, and only cells that lead to the goal are ever visited.
+//
+//   ices::suffix_counts counts(setting);
+//   for (ices::path_enumerator it(counts, first); !it.done(); it.next()) {
+//     use(it.current());
+//   }
+class path_enumerator {
+private:
+  const suffix_counts* counts_;
+  std::vector<step_direction> steps_;
+  bool done_;
+
+  // Extend steps_ with the lexicographically first way to reach the goal
+  // from where it currently ends, which must be a cell with paths to goal.
+  void complete(coordinate row, coordinate column) {
+    const grid& setting = counts_->setting();
+    while (!(row == setting.rows() - 1 && column == setting.columns() - 1)) {
+      if (counts_->after(row, column, STEP_DIRECTION_RIGHT) > 0) {
+        steps_.push_back(STEP_DIRECTION_RIGHT);
+        ++column;
+      } else {
+        steps_.push_back(STEP_DIRECTION_DOWN);
+        ++row;
+      }
+    }
+  }
+
+public:
+
+  // Start at the path with rank first; if there is no such path, the
+  // enumerator is done immediately.
+  explicit path_enumerator(const suffix_counts& counts, path_count first = 0)
+  : counts_(&counts), done_(first >= counts.total()) {
+    if (!done_) {
+      steps_ = unrank_steps(counts, first);
+    }
+  }
+
+  // True once every path from the starting rank has been listed.
+  bool done() const { return done_; }
+
+  // The steps after the start of the current path.
+  const std::vector<step_direction>& steps() const {
+    assert(!done_);
+    return steps_;
+  }
+
+  // The current path.
+  path current() const { return path(counts_->setting(), steps()); }
+
+  // Advance to the next path in lexicographic order.
+  void next() {
+    assert(!done_);
+    const grid& setting = counts_->setting();
+    // The end of the path is always the goal; walk back from it to the
+    // last RIGHT step that could have been a DOWN step instead.
+    coordinate row = setting.rows() - 1, column = setting.columns() - 1;
+    while (!steps_.empty()) {
+      step_direction last = steps_.back();
+      steps_.pop_back();
+      if (last == STEP_DIRECTION_RIGHT) {
+        --column;
+        if (counts_->after(row, column, STEP_DIRECTION_DOWN) > 0) {
+          steps_.push_back(STEP_DIRECTION_DOWN);
+          complete(row + 1, column);
+          return;
+        }
+      } else {
+        --row;
+      }
+    }
+    done_ = true;
+  }
+};
+
+// Packed paths store one bit per step after the start, 64 steps per word,
+// with bit k set when step k is STEP_DIRECTION_RIGHT; the same order as the
+// bitmasks of iceberg_avoiding_exhaustive.
+inline coordinate words_per_path(const grid& setting) {
+  return words_per_row(setting.rows() + setting.columns() - 2);
+}
+
+// Decode a packed path.
+path unpack_path(const grid& setting, const std::uint64_t* words) {
+  path result(setting);
+  const coordinate steps = setting.rows() + setting.columns() - 2;
+  for (coordinate k = 0; k < steps; ++k) {
+    bool right = (words[k / 64] >> (k % 64)) & 1;
+    result.add_step(right ? STEP_DIRECTION_RIGHT : STEP_DIRECTION_DOWN);
+  }
+  return result;
+}
+
+// A path stored in the packed form: one bit per step after the start,
+// set for STEP_DIRECTION_RIGHT, instead of a four-byte step each. Paths of
+// up to 64 * PACKED_PATH_INLINE_WORDS steps live inside the object. Longer
+// grids get one allocation, sized for the longest path, when the path is
+// created, so adding steps never allocates.
+//
+// The number of RIGHT steps is kept alongside the bits, so final_row and
+// final_column are O(1); a path built from packed words counts them with
+// popcount.
+const coordinate PACKED_PATH_INLINE_WORDS = 2;
+
+class packed_path {
+private:
+  const grid* setting_;
+  coordinate steps_, rights_;
+  std::uint64_t inline_[PACKED_PATH_INLINE_WORDS];
+  std::vector<std::uint64_t> heap_;
+
+  std::uint64_t* data() { return heap_.empty() ? inline_ : heap_.data(); }
+
+public:
+
+  // Create an empty path at (0, 0).
+  explicit packed_path(const grid& setting)
+  : setting_(&setting), steps_(0), rights_(0), inline_{0, 0} {
+    if (words_per_path(setting) > PACKED_PATH_INLINE_WORDS) {
+      heap_.assign(words_per_path(setting), 0);
+    }
+  }
+
+  // Create a path from (0, 0) taking the given steps, which must be valid.
+  packed_path(const grid& setting, const std::vector<step_direction>& steps_after_start)
+  : packed_path(setting) {
+    for (auto dir : steps_after_start) {
+      add_step(dir);
+    }
+  }
+
+  // Create a path from its first steps packed bits, as written by
+  // path_sampler::sample_packed. The steps must be valid.
+  packed_path(const grid& setting, const std::uint64_t* words, coordinate steps)
+  : packed_path(setting) {
+    assert(steps <= setting.rows() + setting.columns() - 2);
+    const coordinate count = words_per_row(steps);
+    std::copy(words, words + count, data());
+    if (steps % 64 != 0) {
+      data()[count - 1] &= (std::uint64_t(1) << (steps % 64)) - 1;
+    }
+    steps_ = steps;
+    for (coordinate w = 0; w < count; ++w) {
+      rights_ += __builtin_popcountll(data()[w]);
+    }
+    assert(final_row() < setting.rows() && final_column() < setting.columns());
+  }
+
+  // Convert from a path.
+  explicit packed_path(const path& p)
+  : packed_path(p.setting()) {
+    for (size_t i = 1; i < p.steps().size(); ++i) {
+      add_step(p.steps()[i].direction());
+    }
+  }
+
+  // Convert to a path.
+  path to_path() const {
+    path result(*setting_);
+    for (coordinate k = 0; k < steps_; ++k) {
+      result.add_step(step_at(k));
+    }
+    return result;
+  }
+
+  const grid& setting() const { return *setting_; }
+  const std::uint64_t* words() const { return heap_.empty() ? inline_ : heap_.data(); }
+
+  // Number of steps after the start.
+  coordinate size() const { return steps_; }
+
+  coordinate final_row() const { return steps_ - rights_; }
+  coordinate final_column() const { return rights_; }
+
+  // Return step k after the start, for k < size().
+  step_direction step_at(coordinate k) const {
+    assert(k < steps_);
+    return ((words()[k / 64] >> (k % 64)) & 1) ? STEP_DIRECTION_RIGHT : STEP_DIRECTION_DOWN;
+  }
+
+  // Return true if adding the given step is valid, as in path.
+  bool is_step_valid(step_direction dir) const {
+    return (dir == STEP_DIRECTION_RIGHT) ? setting_->may_step(final_row(), final_column() + 1)
+         : (dir == STEP_DIRECTION_DOWN) ? setting_->may_step(final_row() + 1, final_column())
+         : false;
+  }
+
+  // Add one step, which must be valid as determined by is_step_valid.
+  void add_step(step_direction dir) {
+    assert(is_step_valid(dir));
+    if (dir == STEP_DIRECTION_RIGHT) {
+      data()[steps_ / 64] |= std::uint64_t(1) << (steps_ % 64);
+      ++rights_;
+    }
+    ++steps_;
+  }
+
+  // Remove the last step, for backtracking searches.
+  void remove_last_step() {
+    assert(steps_ > 0);
+    --steps_;
+    std::uint64_t bit = std::uint64_t(1) << (steps_ % 64);
+    if (data()[steps_ / 64] & bit) {
+      data()[steps_ / 64] &= ~bit;
+      --rights_;
+    }
+  }
+
+  // Bits past size() are always clear, so whole words can be compared.
+  bool operator==(const packed_path& o) const {
+    return steps_ == o.steps_ &&
+           std::equal(words(), words() + words_per_row(steps_), o.words());
+  }
+  bool operator!=(const packed_path& o) const { return !(*this == o); }
+};
+
+// Draws valid paths uniformly at random.
+//
+// Construction runs the suffix count DP once, from the bottom row up with
+// two rolling rows of doubles that are rescaled by a power of two after
+// every row, so grids whose counts have thousands of digits are fine. For
+// each cell it keeps only the probability that a uniform path through that
+// cell continues right, as a 32-bit threshold, so the table costs four
+// bytes per cell. A sample then walks from (0, 0) to the goal making one
+// weighted choice per step, in O(rows + columns) time.
+//
+// Probabilities are accurate to about 2^-32 per step, and a step is never
+// taken into an iceberg or a dead end.
+class path_sampler {
+private:
+  const grid* setting_;
+  std::vector<std::uint32_t> thresholds_;
+  bool any_path_;
+
+  // Threshold values: always go down, always go right, and otherwise go
+  // right when a uniform 32-bit number is below the threshold.
+  static constexpr std::uint32_t ALWAYS_DOWN = 0;
+  static constexpr std::uint32_t ALWAYS_RIGHT = 0xffffffffu;
+
+  bool go_right(coordinate row, coordinate column, counter_rng& gen) const {
+    std::uint32_t threshold = thresholds_[row * setting_->columns() + column];
+    return (threshold == ALWAYS_RIGHT) ||
+           (threshold != ALWAYS_DOWN && std::uint32_t(gen() >> 32) < threshold);
+  }
+
+public:
+
+  explicit path_sampler(const grid& setting)
+  : setting_(&setting), thresholds_(setting.rows() * setting.columns(), ALWAYS_DOWN) {
+    const coordinate rows = setting.rows(), columns = setting.columns();
+    // below[c] and here[c] are proportional to the suffix counts of the
+    // row below and of the current row; below[columns] stays 0.
+    std::vector<double> below(columns + 1, 0.0), here(columns + 1, 0.0);
+    for (coordinate r = rows; r-- > 0; ) {
+      double largest = 0;
+      for (coordinate c = columns; c-- > 0; ) {
+        if (setting.get(r, c) == CELL_ICEBERG) {
+          here[c] = 0;
+          continue;
+        }
+        if (r == rows - 1 && c == columns - 1) {
+          here[c] = 1;
+          continue;
+        }
+        double right = here[c + 1], down = below[c];
+        here[c] = right + down;
+        std::uint32_t& threshold = thresholds_[r * columns + c];
+        if (down == 0) {
+          threshold = (right > 0) ? ALWAYS_RIGHT : ALWAYS_DOWN;
+        } else if (right > 0) {
+          double scaled = std::ldexp(right / here[c], 32);
+          threshold = std::uint32_t(std::min(std::max(scaled, 1.0), double(ALWAYS_RIGHT - 1)));
+        }
+        largest = std::max(largest, here[c]);
+      }
+      if (largest > 0) {
+        int exponent;
+        std::frexp(largest, &exponent);
+        for (coordinate c = 0; c < columns; ++c) {
+          here[c] = std::ldexp(here[c], -exponent);
+        }
+      }
+      std::swap(here, below);
+    }
+    any_path_ = below[0] > 0;
+  }
+
+  const grid& setting() const { return *setting_; }
+
+  // True when the grid has at least one valid path; sampling requires it.
+  bool any_path() const { return any_path_; }
+
+  // Draw one path, writing it in the packed form to words_per_path(setting())
+  // words.
+  void sample_packed(counter_rng& gen, std::uint64_t* words) const {
+    assert(any_path_);
+    const coordinate rows = setting_->rows(), columns = setting_->columns();
+    std::fill(words, words + words_per_path(*setting_), 0);
+    coordinate row = 0, column = 0;
+    for (coordinate k = 0; k < rows + columns - 2; ++k) {
+      if (row == rows - 1 || (column != columns - 1 && go_right(row, column, gen))) {
+        words[k / 64] |= std::uint64_t(1) << (k % 64);
+        ++column;
+      } else {
+        ++row;
+      }
+    }
+  }
+
+  // Draw one path.
+  path sample(counter_rng& gen) const {
+    std::vector<std::uint64_t> words(words_per_path(*setting_));
+    sample_packed(gen, words.data());
+    return unpack_path(*setting_, words.data());
+  }
+
+  // Draw count paths across the pool, returning them packed back to back,
+  // words_per_path(setting()) words each. Path i is drawn from stream
+  // first_stream + i of the given seed, so the output does not depend on
+  // the number of threads, and batches with disjoint stream ranges are
+  // independent.
+  std::vector<std::uint64_t> sample_batch(size_t count, std::uint64_t seed,
+                                          std::uint64_t first_stream = 0,
+                                          work_stealing_pool& pool = default_pool()) const {
+    const coordinate words = words_per_path(*setting_);
+    std::vector<std::uint64_t> result(count * words);
+    pool.parallel_for(count, [&](size_t i, unsigned) {
+      counter_rng gen(seed, first_stream + i);
+      sample_packed(gen, &result[i * words]);
+    }, 256);
+    return result;
+  }
+};
+
+}
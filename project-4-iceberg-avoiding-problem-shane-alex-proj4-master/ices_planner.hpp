@@ -0,0 +1,255 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_planner.hpp
+//
+// Choosing how to run the path-count DP from the shape of the grid.
+//
+// The number of paths does not change when the grid is transposed, since
+// RIGHT and DOWN simply trade places. The rolling DP holds one count per
+// column and walks the grid row by row, so for a grid much wider than it is
+// tall it is cheaper to transpose the bit-packed grid up front, which costs
+// a small fraction of the DP, and keep a short count row that stays in
+// cache.
+//
+// The planner looks at the shape and the number of icebergs and picks:
+//
+//   - the sparse solver, when there are so few icebergs that O(k^2)
+//     combinatorics beats touching every cell;
+//   - the streaming solver, for a grid file too large to hold in memory;
+//   - the wavefront, when there are several workers and the grid is large
+//     enough in both directions to keep them busy;
+//   - the rolling DP otherwise;
+//
+// and, for the DP solvers, whether to transpose first.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <iostream>
+#include <string>
+
+#include "ices_io.hpp"
+#include "ices_moves.hpp"
+#include "ices_parallel.hpp"
+#include "ices_sparse.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// Transpose a 64 x 64 bit matrix in place: afterwards bit i of block[j] is
+// what bit j of block[i] was. Each round swaps the off-diagonal quadrants
+// of every sub-block with shifts and masks, 64 bits at a time; six rounds
+// take sub-blocks from 64 x 64 down to 2 x 2.
+inline void transpose_bits(grid_word* block) {
+  grid_word mask = 0x00000000ffffffffull;
+  for (unsigned width = 32; width != 0; width >>= 1, mask ^= mask << width) {
+    for (unsigned k = 0; k < 64; k = ((k | width) + 1) & ~width) {
+      grid_word t = ((block[k] >> width) ^ block[k | width]) & mask;
+      block[k] ^= t << width;
+      block[k | width] ^= t;
+    }
+  }
+}
+
+// Return the transpose of a grid: cell (r, c) of the result is cell (c, r)
+// of setting. Works a 64 x 64 block at a time, in parallel over the rows
+// of the result.
+grid transpose_grid(const grid& setting, work_stealing_pool& pool = default_pool()) {
+  const coordinate rows = setting.columns(), columns = setting.rows(),
+                   stride = words_per_row(columns),
+                   row_blocks = words_per_row(rows);
+  std::vector<grid_word> words(rows * stride, 0);
+  pool.parallel_for(row_blocks, [&](size_t block_row, unsigned) {
+    grid_word block[64];
+    for (coordinate w = 0; w < stride; ++w) {
+      // Rows 64w.. of the input, word block_row, become rows
+      // 64 block_row.. of the output, word w.
+      for (coordinate i = 0; i < 64; ++i) {
+        coordinate r = w * 64 + i;
+        block[i] = (r < setting.rows()) ? setting.row_words(r)[block_row] : 0;
+      }
+      transpose_bits(block);
+      for (coordinate j = 0; j < 64 && block_row * 64 + j < rows; ++j) {
+        words[(block_row * 64 + j) * stride + w] = block[j];
+      }
+    }
+  }, 4);
+  return grid(rows, columns, std::move(words));
+}
+
+enum solver_kind { SOLVER_ROLLING, SOLVER_WAVEFRONT, SOLVER_SPARSE, SOLVER_STREAMING };
+
+inline const char* solver_name(solver_kind solver) {
+  switch (solver) {
+  case SOLVER_ROLLING: return "rolling";
+  case SOLVER_WAVEFRONT: return "wavefront";
+  case SOLVER_SPARSE: return "sparse";
+  case SOLVER_STREAMING: return "streaming";
+  }
+  return "unknown";
+}
+
+// What the planner knows about a grid, and what it decided.
+struct dp_plan {
+  coordinate rows = 0, columns = 0;
+  size_t icebergs = 0;
+  bool icebergs_known = false;
+  unsigned workers = 1;
+
+  solver_kind solver = SOLVER_ROLLING;
+  bool transpose = false;
+  std::string reason;
+
+  double density() const {
+    return icebergs_known ? double(icebergs) / (double(rows) * double(columns)) : 0.0;
+  }
+};
+
+// Thresholds the planner uses.
+struct planner_limits {
+  // Count rows up to this size are left alone. The rolling DP reads its row
+  // front to back, which hardware prefetching handles well, so transposing
+  // only pays off once the row is far beyond the last-level cache.
+  size_t cache_bytes = size_t(1) << 26;
+
+  // Grid files larger than this are streamed instead of loaded.
+  size_t memory_bytes = size_t(1) << 32;
+
+  // The wavefront needs at least this many rows and columns, and this many
+  // cells, to keep several workers busy.
+  coordinate wavefront_side = 2048;
+  double wavefront_cells = double(1 << 24);
+
+  // The sparse solver is chosen when k^2 / 2 pair updates cost less than
+  // this fraction of the cells; a pair update, with its three multiplies,
+  // costs several times a DP cell.
+  double sparse_fraction = 0.1;
+};
+
+// Decide how to solve a rows x columns grid with the given number of
+// icebergs (if known), workers, and whether it is only available as a
+// file of file_bytes bytes.
+dp_plan plan_dp(coordinate rows, coordinate columns, size_t icebergs, bool icebergs_known,
+                unsigned workers, bool from_file = false, size_t file_bytes = 0,
+                const planner_limits& limits = planner_limits()) {
+  dp_plan plan;
+  plan.rows = rows;
+  plan.columns = columns;
+  plan.icebergs = icebergs;
+  plan.icebergs_known = icebergs_known;
+  plan.workers = workers;
+  const double cells = double(rows) * double(columns);
+
+  if (from_file && file_bytes > limits.memory_bytes) {
+    plan.solver = SOLVER_STREAMING;
+    plan.reason = "file of " + std::to_string(file_bytes) + " bytes exceeds the memory limit; "
+                  "streamed rows cannot be transposed";
+    return plan;
+  }
+  if (icebergs_known && double(icebergs) * double(icebergs) / 2 < limits.sparse_fraction * cells) {
+    plan.solver = SOLVER_SPARSE;
+    plan.reason = std::to_string(icebergs) + " icebergs: pairwise combinatorics is cheaper "
+                  "than visiting " + std::to_string(size_t(cells)) + " cells";
+    return plan;
+  }
+
+  const coordinate short_side = std::min(rows, columns);
+  if (workers > 1 && short_side >= limits.wavefront_side && cells >= limits.wavefront_cells) {
+    plan.solver = SOLVER_WAVEFRONT;
+    plan.reason = std::to_string(workers) + " workers and both sides at least " +
+                  std::to_string(limits.wavefront_side);
+  } else {
+    plan.solver = SOLVER_ROLLING;
+    plan.reason = (workers > 1) ? "grid too small or thin to split across workers"
+                                : "one worker";
+  }
+  // The wavefront works in square tiles, and the rolling row is best kept
+  // short once it no longer fits in cache.
+  if (plan.solver == SOLVER_ROLLING && columns > rows &&
+      columns * sizeof(unsigned int) > limits.cache_bytes) {
+    plan.transpose = true;
+    plan.reason += "; count row of " + std::to_string(columns * sizeof(unsigned int)) +
+                   " bytes exceeds cache, transposing to " + std::to_string(short_side) +
+                   " columns";
+  }
+  return plan;
+}
+
+// Print a plan on one line.
+void print_plan(const dp_plan& plan, std::ostream& out) {
+  out << "plan: ";
+  if (plan.rows > 0) {
+    out << plan.rows;
+  } else {
+    out << "?";
+  }
+  out << "x" << plan.columns;
+  if (plan.icebergs_known) {
+    out << ", " << plan.icebergs << " icebergs (density " << plan.density() << ")";
+  }
+  out << ", " << plan.workers << " workers -> " << solver_name(plan.solver)
+      << (plan.transpose ? ", transposed" : "") << " (" << plan.reason << ")" << std::endl;
+}
+
+// Run a plan on a grid in memory.
+unsigned int run_plan(const dp_plan& plan, const grid& setting,
+                      work_stealing_pool& pool = default_pool()) {
+  if (plan.solver == SOLVER_SPARSE) {
+    return iceberg_avoiding_sparse(setting);
+  }
+  if (plan.transpose) {
+    grid transposed = transpose_grid(setting, pool);
+    return (plan.solver == SOLVER_WAVEFRONT) ? iceberg_avoiding_wavefront(transposed, pool)
+                                             : iceberg_avoiding_rolling(transposed);
+  }
+  return (plan.solver == SOLVER_WAVEFRONT) ? iceberg_avoiding_wavefront(setting, pool)
+                                           : iceberg_avoiding_rolling(setting);
+}
+
+// Solve the iceberg avoiding problem for a grid in memory, choosing the
+// solver and orientation with plan_dp. In verbose mode the plan is printed
+// to log first.
+unsigned int iceberg_avoiding_planned(const grid& setting, bool verbose = false,
+                                      work_stealing_pool& pool = default_pool(),
+                                      std::ostream& log = std::clog,
+                                      const planner_limits& limits = planner_limits()) {
+  dp_plan plan = plan_dp(setting.rows(), setting.columns(), iceberg_count(setting), true,
+                         pool.size(), false, 0, limits);
+  if (verbose) {
+    print_plan(plan, log);
+  }
+  return run_plan(plan, setting, pool);
+}
+
+// Solve the iceberg avoiding problem for a grid file. Files small enough
+// to hold are loaded (binary files are mapped) and planned like grids in
+// memory; larger ones are streamed.
+unsigned int iceberg_avoiding_planned(const std::string& filename, bool verbose = false,
+                                      work_stealing_pool& pool = default_pool(),
+                                      std::ostream& log = std::clog,
+                                      const planner_limits& limits = planner_limits()) {
+  struct stat info;
+  if (::stat(filename.c_str(), &info) != 0) {
+    throw std::runtime_error("cannot open " + filename);
+  }
+  auto reader = open_row_reader(filename);
+  dp_plan plan = plan_dp(0, reader->columns(), 0, false, pool.size(), true,
+                         size_t(info.st_size), limits);
+  const bool binary = dynamic_cast<binary_row_reader*>(reader.get()) != nullptr;
+  reader.reset();
+  if (plan.solver == SOLVER_STREAMING) {
+    if (verbose) {
+      print_plan(plan, log);
+    }
+    return iceberg_avoiding_streaming(filename);
+  }
+  grid setting = binary ? map_binary_grid(filename) : load_grid(filename);
+  plan = plan_dp(setting.rows(), setting.columns(), iceberg_count(setting), true,
+                 pool.size(), true, size_t(info.st_size), limits);
+  if (verbose) {
+    print_plan(plan, log);
+  }
+  return run_plan(plan, setting, pool);
+}
+
+}
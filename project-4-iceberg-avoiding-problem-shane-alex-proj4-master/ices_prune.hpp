@@ -0,0 +1,203 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_prune.hpp
+//
+// Reachability pruning: find the cells that lie on at least one valid path,
+// so the DP can skip everything else.
+//
+// A cell is live when it can be reached from (0, 0) and can reach the
+// bottom-right corner. Both properties are computed a whole 64-bit word of
+// cells at a time. Within a row, spreading reachability rightwards through
+// runs of water is an addition: adding the seed bits to the water bits
+// sends a carry along each run from its first seed, flipping exactly the
+// cells the seed reaches. The cells that can reach the goal are found the
+// same way on the grid rotated by 180 degrees.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ices_algs.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// Reverse the order of the bits of a word.
+inline grid_word reverse_bits(grid_word x) {
+  x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+  x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+  x = ((x >> 4) & 0x0f0f0f0f0f0f0f0full) | ((x & 0x0f0f0f0f0f0f0f0full) << 4);
+  return __builtin_bswap64(x);
+}
+
+// The 64 bits of a bit-packed row starting at the given column, which may
+// be negative; bits outside the row are 0.
+inline grid_word extract_bits(const grid_word* row, coordinate words, std::ptrdiff_t start) {
+  auto word_at = [&](std::ptrdiff_t index) {
+    return (index >= 0 && coordinate(index) < words) ? row[index] : grid_word(0);
+  };
+  std::ptrdiff_t index = (start >= 0) ? start / 64 : -((63 - start) / 64);
+  unsigned shift = unsigned(start - index * 64);
+  grid_word low = word_at(index) >> shift;
+  return (shift == 0) ? low : (low | (word_at(index + 1) << (64 - shift)));
+}
+
+// Mirror a bit-packed row: bit c of out is bit columns-1-c of in.
+void reverse_row(const grid_word* in, grid_word* out, coordinate columns) {
+  const coordinate words = words_per_row(columns);
+  for (coordinate k = 0; k < words; ++k) {
+    // Out bits 64k .. 64k+63 come from in bits columns-1-64k downwards.
+    std::ptrdiff_t top = std::ptrdiff_t(columns) - 1 - std::ptrdiff_t(64 * k);
+    out[k] = reverse_bits(extract_bits(in, words, top - 63));
+  }
+  if (columns % GRID_WORD_BITS != 0) {
+    out[words - 1] &= (grid_word(1) << (columns % GRID_WORD_BITS)) - 1;
+  }
+}
+
+// Spread seeds rightwards through runs of water: out is the set of water
+// cells that are seeds or lie to the right of a seed in the same run.
+void fill_right(const grid_word* water, const grid_word* seeds, grid_word* out,
+                coordinate words) {
+  grid_word carry = 0;
+  for (coordinate k = 0; k < words; ++k) {
+    grid_word s = seeds[k] & water[k], sum, total;
+    grid_word carry_out = __builtin_add_overflow(water[k], s, &sum);
+    carry_out |= __builtin_add_overflow(sum, carry, &total);
+    out[k] = water[k] & ((total ^ water[k]) | s);
+    carry = carry_out;
+  }
+}
+
+// Spread reachability from (0, 0) down the grid: reach holds
+// rows * words_per_row(columns) words, and receives the cells reachable
+// from (0, 0) of a grid whose bit-packed water rows are given by
+// water_row(r).
+template <typename WaterRow>
+void forward_reachable(coordinate rows, coordinate columns, WaterRow&& water_row,
+                       std::vector<grid_word>& reach) {
+  const coordinate words = words_per_row(columns);
+  reach.assign(rows * words, 0);
+  std::vector<grid_word> seeds(words, 0);
+  seeds[0] = 1;
+  for (coordinate r = 0; r < rows; ++r) {
+    const grid_word* water = water_row(r);
+    if (r > 0) {
+      std::copy(&reach[(r - 1) * words], &reach[r * words], seeds.begin());
+    }
+    fill_right(water, seeds.data(), &reach[r * words], words);
+  }
+}
+
+// The live cells of a grid, and each row's interval of live columns.
+class live_cells {
+private:
+  coordinate rows_, columns_, words_;
+
+  // Bit set for every cell that is not live, so rows can be passed to
+  // advance_count_range in place of the grid's icebergs.
+  std::vector<grid_word> dead_;
+  std::vector<coordinate> first_, end_;
+  bool any_path_;
+
+public:
+
+  explicit live_cells(const grid& setting)
+  : rows_(setting.rows()), columns_(setting.columns()),
+    words_(words_per_row(setting.columns())),
+    first_(setting.rows(), 0), end_(setting.rows(), 0) {
+
+    const coordinate tail = columns_ % GRID_WORD_BITS;
+    const grid_word tail_mask = tail ? (grid_word(1) << tail) - 1 : ~grid_word(0);
+
+    // Water rows, and the same rows rotated by 180 degrees.
+    std::vector<grid_word> water(rows_ * words_), rotated(rows_ * words_);
+    for (coordinate r = 0; r < rows_; ++r) {
+      const grid_word* cells = setting.row_words(r);
+      for (coordinate k = 0; k < words_; ++k) {
+        water[r * words_ + k] = ~cells[k];
+      }
+      water[r * words_ + words_ - 1] &= tail_mask;
+      reverse_row(&water[r * words_], &rotated[(rows_ - 1 - r) * words_], columns_);
+    }
+
+    std::vector<grid_word> reach, coreach;
+    forward_reachable(rows_, columns_, [&](coordinate r) { return &water[r * words_]; }, reach);
+    any_path_ = (reach[(rows_ - 1) * words_ + (columns_ - 1) / GRID_WORD_BITS]
+                 >> ((columns_ - 1) % GRID_WORD_BITS)) & 1;
+    dead_.assign(rows_ * words_, ~grid_word(0));
+    if (!any_path_) {
+      return;
+    }
+    forward_reachable(rows_, columns_, [&](coordinate r) { return &rotated[r * words_]; }, coreach);
+
+    std::vector<grid_word> unrotated(words_);
+    for (coordinate r = 0; r < rows_; ++r) {
+      reverse_row(&coreach[(rows_ - 1 - r) * words_], unrotated.data(), columns_);
+      coordinate first = columns_, end = 0;
+      for (coordinate k = 0; k < words_; ++k) {
+        grid_word live = reach[r * words_ + k] & unrotated[k];
+        dead_[r * words_ + k] = ~live;
+        if (live != 0) {
+          first = std::min(first, k * GRID_WORD_BITS + __builtin_ctzll(live));
+          end = k * GRID_WORD_BITS + GRID_WORD_BITS - __builtin_clzll(live);
+        }
+      }
+      first_[r] = first;
+      end_[r] = end;
+    }
+  }
+
+  // True when the grid has at least one valid path. Otherwise no cell is
+  // live.
+  bool any_path() const { return any_path_; }
+
+  // Whether the given cell lies on a valid path.
+  bool is_live(coordinate row, coordinate column) const {
+    return !((dead_[row * words_ + column / GRID_WORD_BITS] >> (column % GRID_WORD_BITS)) & 1);
+  }
+
+  // The bit-packed cells of a row that are not live.
+  const grid_word* dead_words(coordinate row) const { return &dead_[row * words_]; }
+
+  // The live cells of a row all lie in columns [first(row), end(row)).
+  coordinate first(coordinate row) const { return first_[row]; }
+  coordinate end(coordinate row) const { return end_[row]; }
+};
+
+// Solve the iceberg avoiding problem for the given grid, using a dynamic
+// programming algorithm restricted to live cells. Returns 0 right after the
+// reachability pass when there is no valid path; otherwise each row's DP
+// only covers that row's live columns.
+//
+// The grid must be non-empty.
+unsigned int iceberg_avoiding_pruned(const grid& setting) {
+
+  // grid must be non-empty.
+  assert(setting.rows() > 0);
+  assert(setting.columns() > 0);
+
+  live_cells live(setting);
+  if (!live.any_path()) {
+    return 0;
+  }
+
+  // Outside the previous row's live interval, counts are always 0.
+  std::vector<unsigned int> counts(setting.columns(), 0);
+  counts[0] = 1;
+  coordinate previous_first = 0, previous_end = 1;
+  for (coordinate r = 0; r < setting.rows(); ++r) {
+    coordinate first = live.first(r), end = live.end(r);
+    for (coordinate c = previous_first; c < std::min(previous_end, first); ++c) {
+      counts[c] = 0;
+    }
+    for (coordinate c = std::max(previous_first, end); c < previous_end; ++c) {
+      counts[c] = 0;
+    }
+    advance_count_range(live.dead_words(r), counts.data(), first, end);
+    previous_first = first;
+    previous_end = end;
+  }
+  return counts[setting.columns() - 1];
+}
+
+}
@@ -0,0 +1,214 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_queries.hpp
+//
+// Answering many path-count queries between arbitrary cells of one grid.
+//
+// A query asks for the number of paths from (from_row, from_column) to
+// (to_row, to_column) moving only RIGHT and DOWN through water, modulo
+// 2^32. Such paths stay inside the rectangle the two cells span, so one
+// query can be answered by the rolling DP over that rectangle.
+//
+// For a batch of queries the rows are split in half recursively. A path
+// from above the split to below it steps DOWN across the split exactly
+// once, from some (mid, c) to (mid + 1, c), so its query's answer is
+//
+//   sum over c of  paths(source -> (mid, c)) * paths((mid + 1, c) -> target).
+//
+// The first factor, for every c at once, is one DP down from the source;
+// the second is one DP up from the target. Queries sharing a source or a
+// target share those DPs, so a batch of S sources and T targets in any
+// combination costs S + T DPs plus one dot product per query, instead of
+// one DP per query. Queries that do not cross the split are passed to the
+// half they lie in.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include "ices_algs.hpp"
+#include "ices_parallel.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// A request for the number of paths between two cells.
+struct path_query {
+  coordinate from_row, from_column, to_row, to_column;
+};
+
+// Answer one query with the rolling DP over its rectangle. Returns 0 when
+// the target is above or left of the source, or either is an iceberg.
+unsigned int count_paths_between(const grid& setting, const path_query& query) {
+  assert(query.to_row < setting.rows());
+  assert(query.to_column < setting.columns());
+  if (query.to_row < query.from_row || query.to_column < query.from_column) {
+    return 0;
+  }
+  // Columns are indexed absolutely, so the count row starts at column 0.
+  std::vector<unsigned int> counts(query.to_column + 1, 0);
+  counts[query.from_column] = 1;
+  for (coordinate r = query.from_row; r <= query.to_row; ++r) {
+    advance_count_range(setting.row_words(r), counts.data(), query.from_column,
+                        query.to_column + 1);
+  }
+  return counts.back();
+}
+
+// Counts from (from_row, from_column) to every column of row last_row,
+// over columns [from_column, end). Entries left of from_column are 0.
+std::vector<unsigned int> counts_down_to(const grid& setting, coordinate from_row,
+                                         coordinate from_column, coordinate last_row,
+                                         coordinate end) {
+  std::vector<unsigned int> counts(end, 0);
+  counts[from_column] = 1;
+  for (coordinate r = from_row; r <= last_row; ++r) {
+    advance_count_range(setting.row_words(r), counts.data(), from_column, end);
+  }
+  return counts;
+}
+
+// Counts from every column of row first_row to (to_row, to_column), over
+// columns [first, to_column], moving UP and LEFT from the target. Entries
+// right of to_column are absent.
+std::vector<unsigned int> counts_up_to(const grid& setting, coordinate to_row,
+                                       coordinate to_column, coordinate first_row,
+                                       coordinate first) {
+  std::vector<unsigned int> counts(to_column + 1, 0);
+  counts[to_column] = 1;
+  for (coordinate r = to_row + 1; r-- > first_row; ) {
+    const grid_word* icebergs = setting.row_words(r);
+    unsigned int from_right = 0;
+    for (coordinate c = to_column + 1; c-- > first; ) {
+      unsigned int water = unsigned(((icebergs[c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS)) & 1) ^ 1);
+      from_right = (counts[c] + from_right) & (0u - water);
+      counts[c] = from_right;
+    }
+  }
+  return counts;
+}
+
+// Row ranges of at least this many rows solve their two halves in
+// parallel.
+const coordinate QUERY_FORK_ROWS = 256;
+
+// Answer the queries listed in indices, all of whose rows lie in
+// [low, high], into answers. Every query must have its target below and
+// right of its source.
+void answer_query_rows(const grid& setting, const std::vector<path_query>& queries,
+                       std::vector<coordinate> indices, coordinate low, coordinate high,
+                       std::vector<unsigned int>& answers, work_stealing_pool& pool) {
+  if (indices.empty()) {
+    return;
+  }
+  if (low == high) {
+    // Paths along a single row.
+    for (coordinate i : indices) {
+      answers[i] = count_paths_between(setting, queries[i]);
+    }
+    return;
+  }
+
+  const coordinate mid = low + (high - low) / 2;
+  std::vector<coordinate> upper, lower, crossing;
+  for (coordinate i : indices) {
+    const path_query& query = queries[i];
+    if (query.to_row <= mid) {
+      upper.push_back(i);
+    } else if (query.from_row > mid) {
+      lower.push_back(i);
+    } else {
+      crossing.push_back(i);
+    }
+  }
+  indices.clear();
+  indices.shrink_to_fit();
+
+  // One DP per distinct source, down to row mid, wide enough for all its
+  // queries; one per distinct target, up to row mid + 1.
+  typedef std::pair<coordinate, coordinate> cell;
+  std::map<cell, coordinate> source_slot, target_slot;
+  std::vector<cell> sources, targets;
+  std::vector<coordinate> source_end, target_first, source_of(crossing.size()),
+                          target_of(crossing.size());
+  for (coordinate k = 0; k < crossing.size(); ++k) {
+    const path_query& query = queries[crossing[k]];
+    auto s = source_slot.emplace(cell(query.from_row, query.from_column), sources.size());
+    if (s.second) {
+      sources.push_back(s.first->first);
+      source_end.push_back(0);
+    }
+    source_of[k] = s.first->second;
+    source_end[source_of[k]] = std::max(source_end[source_of[k]], query.to_column + 1);
+    auto t = target_slot.emplace(cell(query.to_row, query.to_column), targets.size());
+    if (t.second) {
+      targets.push_back(t.first->first);
+      target_first.push_back(query.from_column);
+    }
+    target_of[k] = t.first->second;
+    target_first[target_of[k]] = std::min(target_first[target_of[k]], query.from_column);
+  }
+  std::vector<std::vector<unsigned int>> down(sources.size()), up(targets.size());
+  pool.parallel_for(sources.size() + targets.size(), [&](size_t k, unsigned) {
+    if (k < sources.size()) {
+      down[k] = counts_down_to(setting, sources[k].first, sources[k].second, mid,
+                               source_end[k]);
+    } else {
+      k -= sources.size();
+      up[k] = counts_up_to(setting, targets[k].first, targets[k].second, mid + 1,
+                           target_first[k]);
+    }
+  });
+  pool.parallel_for(crossing.size(), [&](size_t k, unsigned) {
+    const path_query& query = queries[crossing[k]];
+    const auto& above = down[source_of[k]];
+    const auto& below = up[target_of[k]];
+    unsigned int total = 0;
+    for (coordinate c = query.from_column; c <= query.to_column; ++c) {
+      total += above[c] * below[c];
+    }
+    answers[crossing[k]] = total;
+  }, 64);
+  down.clear();
+  up.clear();
+
+  if (high - low + 1 >= QUERY_FORK_ROWS) {
+    task_group halves(pool);
+    halves.run([&]() {
+      answer_query_rows(setting, queries, std::move(upper), low, mid, answers, pool);
+    });
+    answer_query_rows(setting, queries, std::move(lower), mid + 1, high, answers, pool);
+    halves.wait();
+  } else {
+    answer_query_rows(setting, queries, std::move(upper), low, mid, answers, pool);
+    answer_query_rows(setting, queries, std::move(lower), mid + 1, high, answers, pool);
+  }
+}
+
+// Answer a batch of queries on one grid, by divide and conquer over rows.
+// answers[i] is the answer to queries[i], as from count_paths_between.
+std::vector<unsigned int> count_paths_between(const grid& setting,
+                                              const std::vector<path_query>& queries,
+                                              work_stealing_pool& pool = default_pool()) {
+  std::vector<unsigned int> answers(queries.size(), 0);
+  std::vector<coordinate> indices;
+  for (coordinate i = 0; i < queries.size(); ++i) {
+    const path_query& query = queries[i];
+    assert(query.to_row < setting.rows());
+    assert(query.to_column < setting.columns());
+    assert(query.from_row < setting.rows());
+    assert(query.from_column < setting.columns());
+    if (query.from_row <= query.to_row && query.from_column <= query.to_column) {
+      indices.push_back(i);
+    }
+  }
+  if (setting.rows() > 0) {
+    answer_query_rows(setting, queries, std::move(indices), 0, setting.rows() - 1, answers, pool);
+  }
+  return answers;
+}
+
+}
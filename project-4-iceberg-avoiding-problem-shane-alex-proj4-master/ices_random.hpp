@@ -0,0 +1,283 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_random.hpp
+//
+// Random grid generation that scales to very large grids.
+//
+// grid::random shuffles a list of every cell position, which needs memory
+// proportional to the whole grid several times over. The generators here
+// decide how many icebergs go in each row, then sample the iceberg columns
+// of every row directly into the bit-packed row with Floyd's algorithm, so
+// the only memory used is the grid itself. Rows are generated in parallel,
+// each from its own counter-based random stream, so the output depends only
+// on the seed and not on the number of threads.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+
+#include "ices_parallel.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// A counter-based random number generator: the i-th number of a stream is
+// a fixed function of (seed, stream, i), so any number of streams can be
+// created independently and in any order. The mixing function is the
+// SplitMix64 finalizer.
+//
+// Satisfies the UniformRandomBitGenerator requirements.
+class counter_rng {
+private:
+  std::uint64_t key_, counter_;
+
+  static std::uint64_t mix(std::uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+public:
+  using result_type = std::uint64_t;
+
+  counter_rng(std::uint64_t seed, std::uint64_t stream)
+  : key_(mix(seed + 0x9e3779b97f4a7c15ull) ^ mix(stream * 0xd1b54a32d192ed03ull + 1)),
+    counter_(0) { }
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return ~result_type(0); }
+
+  result_type operator()() {
+    return mix(key_ + 0x9e3779b97f4a7c15ull * ++counter_);
+  }
+
+  // Return a uniformly distributed number in [0, bound), using Lemire's
+  // multiply-and-reject method. bound must be positive.
+  std::uint64_t below(std::uint64_t bound) {
+    assert(bound > 0);
+    __uint128_t product = __uint128_t((*this)()) * bound;
+    std::uint64_t low = std::uint64_t(product);
+    if (low < bound) {
+      std::uint64_t threshold = (0 - bound) % bound;
+      while (low < threshold) {
+        product = __uint128_t((*this)()) * bound;
+        low = std::uint64_t(product);
+      }
+    }
+    return std::uint64_t(product >> 64);
+  }
+};
+
+// Random streams used by the generators. Row r uses stream r + 1, and
+// sequential work uses stream 0.
+const std::uint64_t ROW_SPLIT_STREAM = 0;
+
+// The columns of a row that may hold an iceberg: every column except
+// (0, 0) and (rows-1, columns-1).
+inline std::pair<coordinate, coordinate> open_columns(coordinate rows, coordinate columns,
+                                                      coordinate row) {
+  coordinate first = (row == 0) ? 1 : 0,
+             end = (row == rows - 1) ? columns - 1 : columns;
+  return {first, std::max(first, end)};
+}
+
+// Invert columns [first, end) of a bit-packed row, a word at a time.
+void flip_columns(grid_word* row, coordinate first, coordinate end) {
+  for (coordinate c = first; c < end; ) {
+    coordinate offset = c % GRID_WORD_BITS,
+               bits = std::min(GRID_WORD_BITS - offset, end - c);
+    grid_word mask = (bits == GRID_WORD_BITS) ? ~grid_word(0) : ((grid_word(1) << bits) - 1);
+    row[c / GRID_WORD_BITS] ^= mask << offset;
+    c += bits;
+  }
+}
+
+// Set exactly count distinct random bits among columns [first, end) of an
+// all-water bit-packed row. Floyd's algorithm draws one number per chosen
+// bit and uses the row itself as the set of chosen bits. When more than
+// half the columns are chosen, the complement is sampled instead.
+void sample_row(grid_word* row, coordinate first, coordinate end,
+                coordinate count, counter_rng& gen) {
+  const coordinate n = end - first;
+  assert(count <= n);
+  const bool complement = count > n / 2;
+  const coordinate chosen = complement ? n - count : count;
+
+  auto test = [&](coordinate c) {
+    return (row[c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS)) & 1;
+  };
+  auto flip = [&](coordinate c) {
+    row[c / GRID_WORD_BITS] ^= grid_word(1) << (c % GRID_WORD_BITS);
+  };
+
+  for (coordinate j = n - chosen; j < n; ++j) {
+    coordinate t = first + gen.below(j + 1);
+    flip(test(t) ? first + j : t);
+  }
+  if (complement) {
+    flip_columns(row, first, end);
+  }
+}
+
+// Fill every row of a rows x columns bit-packed grid so that each open cell
+// (see open_columns) is set independently with the given probability. Each
+// row draws its count from a binomial distribution and places the bits with
+// sample_row, all from the row's own stream, so rows are filled in
+// parallel. The number of bits set in each row is stored in row_counts.
+void fill_rows_bernoulli(std::vector<grid_word>& words, coordinate rows, coordinate columns,
+                         double density, std::uint64_t seed, work_stealing_pool& pool,
+                         std::vector<coordinate>& row_counts) {
+  const coordinate stride = words_per_row(columns);
+  words.assign(rows * stride, 0);
+  row_counts.assign(rows, 0);
+  pool.parallel_for(rows, [&](size_t r, unsigned) {
+    auto span = open_columns(rows, columns, r);
+    coordinate cells = span.second - span.first;
+    counter_rng gen(seed, r + 1);
+    std::binomial_distribution<coordinate> count(cells, density);
+    row_counts[r] = std::min(count(gen), cells);
+    sample_row(&words[r * stride], span.first, span.second, row_counts[r], gen);
+  }, 64);
+}
+
+// Create a random grid where every cell other than (0, 0) and
+// (rows-1, columns-1) is an iceberg independently with the given
+// probability, from the given seed. Rows are generated in parallel.
+grid random_grid_density(coordinate rows, coordinate columns, double density,
+                         std::uint64_t seed, work_stealing_pool& pool = default_pool()) {
+
+  assert(rows > 0);
+  assert(columns > 0);
+  assert(density >= 0 && density <= 1);
+
+  std::vector<grid_word> words;
+  std::vector<coordinate> row_counts;
+  fill_rows_bernoulli(words, rows, columns, density, seed, pool, row_counts);
+  return grid(rows, columns, std::move(words));
+}
+
+// Create a random grid like random_grid_density, except that each row
+// keeps its icebergs only with probability row_fraction and is otherwise
+// all water, giving bands of empty rows.
+grid random_banded_grid(coordinate rows, coordinate columns, double density,
+                        double row_fraction, std::uint64_t seed,
+                        work_stealing_pool& pool = default_pool()) {
+
+  assert(row_fraction >= 0 && row_fraction <= 1);
+
+  std::vector<grid_word> words;
+  std::vector<coordinate> row_counts;
+  fill_rows_bernoulli(words, rows, columns, density, seed, pool, row_counts);
+  const coordinate stride = words_per_row(columns);
+  // Stream 0 is unused by fill_rows_bernoulli, whose rows start at 1.
+  counter_rng gen(seed, 0);
+  std::bernoulli_distribution keep(row_fraction);
+  for (coordinate r = 0; r < rows; ++r) {
+    if (!keep(gen)) {
+      std::fill(words.begin() + r * stride, words.begin() + (r + 1) * stride, 0);
+    }
+  }
+  return grid(rows, columns, std::move(words));
+}
+
+// Create a random grid with exactly thicket_count icebergs, none of them at
+// (0, 0) or (rows-1, columns-1), from the given seed. Every such placement
+// is equally likely.
+//
+// Rows are first filled in parallel as in random_grid_density, with the
+// density that gives thicket_count icebergs on average. The small
+// difference from the exact count is then made up sequentially, adding
+// icebergs at uniformly random water cells or removing uniformly random
+// icebergs. Each step treats every cell alike, so the final placement is
+// uniform. When more than half the open cells are icebergs, the water
+// cells are sampled this way instead.
+grid random_grid(coordinate rows, coordinate columns, coordinate thicket_count,
+                 std::uint64_t seed, work_stealing_pool& pool = default_pool()) {
+
+  assert(rows > 0);
+  assert(columns > 0);
+
+  const coordinate open_cells = rows * columns - ((rows * columns > 1) ? 2 : 1);
+  assert(thicket_count <= open_cells);
+
+  const bool complement = thicket_count > open_cells / 2;
+  const coordinate target = complement ? open_cells - thicket_count : thicket_count;
+  const coordinate stride = words_per_row(columns);
+
+  std::vector<grid_word> words;
+  std::vector<coordinate> row_counts;
+  fill_rows_bernoulli(words, rows, columns,
+                      (open_cells == 0) ? 0.0 : double(target) / open_cells,
+                      seed, pool, row_counts);
+
+  auto test = [&](coordinate r, coordinate c) {
+    return (words[r * stride + c / GRID_WORD_BITS] >> (c % GRID_WORD_BITS)) & 1;
+  };
+  auto flip = [&](coordinate r, coordinate c) {
+    words[r * stride + c / GRID_WORD_BITS] ^= grid_word(1) << (c % GRID_WORD_BITS);
+  };
+
+  // A Fenwick tree over row_counts, to find the row holding the k-th set
+  // bit in O(log rows).
+  std::vector<coordinate> tree(rows + 1, 0);
+  auto tree_add = [&](coordinate r, std::ptrdiff_t delta) {
+    for (coordinate i = r + 1; i <= rows; i += i & (0 - i)) {
+      tree[i] += delta;
+    }
+  };
+  coordinate total = 0;
+  for (coordinate r = 0; r < rows; ++r) {
+    tree_add(r, row_counts[r]);
+    total += row_counts[r];
+  }
+
+  counter_rng gen(seed, ROW_SPLIT_STREAM);
+  while (total < target) {
+    // At most half the open cells are set, so this succeeds at least half
+    // the time.
+    coordinate r = gen.below(rows), c = gen.below(columns);
+    auto span = open_columns(rows, columns, r);
+    if (c >= span.first && c < span.second && !test(r, c)) {
+      flip(r, c);
+      tree_add(r, 1);
+      ++total;
+    }
+  }
+  while (total > target) {
+    // Find the row and column of the k-th set bit.
+    coordinate k = gen.below(total), r = 0;
+    for (coordinate step = coordinate(1) << 62; step > 0; step >>= 1) {
+      if (r + step <= rows && tree[r + step] <= k) {
+        r += step;
+        k -= tree[r];
+      }
+    }
+    const grid_word* row = &words[r * stride];
+    coordinate w = 0;
+    while (coordinate(__builtin_popcountll(row[w])) <= k) {
+      k -= __builtin_popcountll(row[w]);
+      ++w;
+    }
+    grid_word word = row[w];
+    for (; k > 0; --k) {
+      word &= word - 1;
+    }
+    flip(r, w * GRID_WORD_BITS + __builtin_ctzll(word));
+    tree_add(r, -1);
+    --total;
+  }
+
+  if (complement) {
+    pool.parallel_for(rows, [&](size_t r, unsigned) {
+      auto span = open_columns(rows, columns, r);
+      flip_columns(&words[r * stride], span.first, span.second);
+    }, 64);
+  }
+
+  return grid(rows, columns, std::move(words));
+}
+
+}
@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_shared.hpp
+//
+// Read-only grids shared between processes.
+//
+// When several analysis processes work on the same large grid file at
+// once, loading a copy in each multiplies the memory used and makes every
+// process read the whole file before it starts. Mapping the binary file
+// with MAP_SHARED instead gives a grid view onto the kernel's page cache:
+// the cells occupy memory once however many processes read them, and a
+// process can start as soon as the file is mapped.
+//
+// The DPs read rows from top to bottom, so the mapping is advised
+// MADV_SEQUENTIAL, and iceberg_avoiding_prefetched asks the kernel
+// (MADV_WILLNEED) to read the next window of rows while the current one is
+// being processed, so that disk reads overlap the computation when the file
+// is not already cached.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ices_algs.hpp"
+#include "ices_io.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// Bytes of rows iceberg_avoiding_prefetched asks for ahead of the row it is
+// working on.
+const size_t PREFETCH_WINDOW_BYTES = size_t(4) << 20;
+
+// Pass advice, such as MADV_WILLNEED, to the kernel for rows [first, first
+// + count) of a grid view. Does nothing for grids that own their rows.
+// Advice is only a hint, so failures are ignored.
+void advise_rows(const grid& setting, coordinate first, coordinate count, int advice) {
+  if (!setting.is_view() || first >= setting.rows() || count == 0) {
+    return;
+  }
+  count = std::min(count, setting.rows() - first);
+  static const uintptr_t page = uintptr_t(::sysconf(_SC_PAGESIZE));
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(setting.row_words(first)),
+                  end = reinterpret_cast<uintptr_t>(setting.row_words(first + count - 1) +
+                                                    setting.stride()),
+                  aligned = begin & ~(page - 1);
+  ::madvise(reinterpret_cast<void*>(aligned), end - aligned, advice);
+}
+
+// Map a binary grid file shared and read-only, and return a view of it,
+// advised for reading from top to bottom. Throws std::runtime_error as
+// map_binary_grid does.
+grid share_binary_grid(const std::string& filename) {
+  size_t offset = 0;
+  grid view = view_binary_record(map_file(filename, true), offset, filename);
+  advise_rows(view, 0, view.rows(), MADV_SEQUENTIAL);
+  return view;
+}
+
+// Solve the iceberg avoiding problem with the rolling DP, asking for each
+// window of rows to be read in while the previous one is processed. On a
+// grid that owns its rows this is iceberg_avoiding_rolling.
+//
+// The grid must be non-empty.
+unsigned int iceberg_avoiding_prefetched(const grid& setting,
+                                         size_t window_bytes = PREFETCH_WINDOW_BYTES) {
+
+  // grid must be non-empty.
+  assert(setting.rows() > 0);
+  assert(setting.columns() > 0);
+
+  const coordinate rows = setting.rows(), columns = setting.columns(),
+                   window = std::max<coordinate>(
+                       1, window_bytes / (setting.stride() * sizeof(grid_word)));
+  std::vector<unsigned int> counts(columns, 0);
+  counts[0] = 1;
+  advise_rows(setting, 0, window, MADV_WILLNEED);
+  for (coordinate r = 0; r < rows; ++r) {
+    if (r % window == 0) {
+      advise_rows(setting, r + window, window, MADV_WILLNEED);
+    }
+    advance_count_row(setting.row_words(r), counts.data(), columns);
+  }
+  return counts.back();
+}
+
+}
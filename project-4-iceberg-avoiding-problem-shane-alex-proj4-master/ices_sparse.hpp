@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_sparse.hpp
+//
+// Path counting by combinatorics, for grids with few icebergs.
+//
+// With no icebergs, the number of paths from (r0, c0) to (r1, c1) is the
+// binomial coefficient C((r1 - r0) + (c1 - c0), r1 - r0). With icebergs,
+// count for each iceberg the paths that reach it without touching any
+// earlier iceberg, by subtracting from all paths to it those that first
+// hit some earlier iceberg; the goal is handled as one more "iceberg". That
+// takes O(k^2) time for k icebergs, independent of the grid's area.
+//
+// Binomials are needed modulo 2^32, where only odd numbers can be divided
+// by. So each factorial is stored as its odd part and its power of two;
+// odd parts are divided with modular inverses, and the powers of two are
+// subtracted (Kummer's theorem) and applied at the end.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+
+#include "ices_types.hpp"
+
+namespace ices {
+
+// Binomial coefficients C(n, k) modulo 2^32, for n up to a fixed limit.
+class binomial_table {
+private:
+  // n! = odd_[n] * 2^twos_[n], modulo 2^32 in the odd part.
+  std::vector<std::uint32_t> odd_, inverse_odd_;
+  std::vector<std::uint64_t> twos_;
+
+  // The inverse of an odd number modulo 2^32, by Newton's iteration; each
+  // step doubles the number of correct low bits, starting from 3.
+  static std::uint32_t inverse(std::uint32_t a) {
+    std::uint32_t x = a;
+    for (int i = 0; i < 4; ++i) {
+      x *= 2 - a * x;
+    }
+    return x;
+  }
+
+public:
+
+  explicit binomial_table(coordinate limit)
+  : odd_(limit + 1), inverse_odd_(limit + 1), twos_(limit + 1) {
+    odd_[0] = 1;
+    twos_[0] = 0;
+    for (coordinate n = 1; n <= limit; ++n) {
+      coordinate m = n;
+      unsigned shift = __builtin_ctzll(m);
+      odd_[n] = odd_[n - 1] * std::uint32_t(m >> shift);
+      twos_[n] = twos_[n - 1] + shift;
+    }
+    for (coordinate n = 0; n <= limit; ++n) {
+      inverse_odd_[n] = inverse(odd_[n]);
+    }
+  }
+
+  coordinate limit() const { return odd_.size() - 1; }
+
+  // C(n, k) modulo 2^32; 0 when k > n.
+  std::uint32_t operator()(coordinate n, coordinate k) const {
+    assert(n <= limit());
+    if (k > n) {
+      return 0;
+    }
+    std::uint64_t twos = twos_[n] - twos_[k] - twos_[n - k];
+    if (twos >= 32) {
+      return 0;
+    }
+    return (odd_[n] * inverse_odd_[k] * inverse_odd_[n - k]) << twos;
+  }
+
+  // The number of paths with no icebergs from (r0, c0) to (r1, c1),
+  // modulo 2^32; 0 if (r1, c1) is not below and to the right.
+  std::uint32_t paths(coordinate r0, coordinate c0, coordinate r1, coordinate c1) const {
+    if (r1 < r0 || c1 < c0) {
+      return 0;
+    }
+    return (*this)((r1 - r0) + (c1 - c0), r1 - r0);
+  }
+};
+
+// The positions of every iceberg, in row-major order.
+std::vector<std::pair<coordinate, coordinate>> iceberg_positions(const grid& setting) {
+  std::vector<std::pair<coordinate, coordinate>> result;
+  const coordinate words = words_per_row(setting.columns());
+  for (coordinate r = 0; r < setting.rows(); ++r) {
+    const grid_word* row = setting.row_words(r);
+    for (coordinate w = 0; w < words; ++w) {
+      for (grid_word bits = row[w]; bits != 0; bits &= bits - 1) {
+        result.emplace_back(r, w * GRID_WORD_BITS + __builtin_ctzll(bits));
+      }
+    }
+  }
+  return result;
+}
+
+// Count the icebergs of a grid a word at a time.
+size_t iceberg_count(const grid& setting) {
+  size_t count = 0;
+  const coordinate words = words_per_row(setting.columns());
+  for (coordinate r = 0; r < setting.rows(); ++r) {
+    const grid_word* row = setting.row_words(r);
+    for (coordinate w = 0; w < words; ++w) {
+      count += __builtin_popcountll(row[w]);
+    }
+  }
+  return count;
+}
+
+// Solve the iceberg avoiding problem by inclusion-exclusion over the
+// icebergs, in O(k^2 + rows + columns) time for k icebergs. Counts are
+// modulo 2^32, like iceberg_avoiding_dyn_prog.
+//
+// The grid must be non-empty.
+unsigned int iceberg_avoiding_sparse(const grid& setting) {
+
+  // grid must be non-empty.
+  assert(setting.rows() > 0);
+  assert(setting.columns() > 0);
+
+  const coordinate goal_row = setting.rows() - 1, goal_column = setting.columns() - 1;
+  if (setting.get(goal_row, goal_column) == CELL_ICEBERG) {
+    return 0;
+  }
+  binomial_table binomial(goal_row + goal_column);
+  auto points = iceberg_positions(setting);
+  points.emplace_back(goal_row, goal_column);
+
+  // first_hit[i]: paths from (0, 0) to points[i] touching no other point.
+  // Row-major order puts every point that can precede i before it.
+  std::vector<std::uint32_t> first_hit(points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    auto [row, column] = points[i];
+    std::uint32_t count = binomial.paths(0, 0, row, column);
+    for (size_t j = 0; j < i; ++j) {
+      if (points[j].second <= column) {
+        count -= first_hit[j] * binomial.paths(points[j].first, points[j].second, row, column);
+      }
+    }
+    first_hit[i] = count;
+  }
+  return first_hit.back();
+}
+
+}
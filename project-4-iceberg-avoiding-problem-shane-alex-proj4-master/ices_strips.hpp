@@ -0,0 +1,233 @@
+///////////////////////////////////////////////////////////////////////////////
+// ices_strips.hpp
+//
+// A multi-process solver for grids too wide for one process's count row.
+//
+// The columns are split into strips, and a worker process is forked for
+// each. A worker keeps a count row for its own strip only. For each grid
+// row it needs one number from the strip to its left, the count leaving
+// that strip's last column, and produces the same number for the strip to
+// its right. Those numbers flow through a ring buffer in shared anonymous
+// memory between each pair of neighbours, so strip k can work on row r
+// while strip k + 1 is still on row r - 1, and all the strips run as a
+// pipeline. Everything stays on the local machine; there is no network and
+// no file other than the grid.
+//
+// Strip boundaries fall on whole grid words, so a worker reads its cells
+// straight out of the bit-packed rows.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ices_algs.hpp"
+#include "ices_io.hpp"
+#include "ices_types.hpp"
+
+namespace ices {
+
+// Number of row counts each ring buffer holds.
+const size_t STRIP_RING_SLOTS = 4096;
+
+// A single-producer, single-consumer queue of counts in shared memory. The
+// atomics are lock-free, so they work across processes.
+struct strip_channel {
+  alignas(64) std::atomic<std::uint64_t> written;
+  alignas(64) std::atomic<std::uint64_t> read;
+  alignas(64) unsigned int slots[STRIP_RING_SLOTS];
+
+  void push(unsigned int value) {
+    std::uint64_t position = written.load(std::memory_order_relaxed);
+    while (position - read.load(std::memory_order_acquire) == STRIP_RING_SLOTS) {
+      std::this_thread::yield();
+    }
+    slots[position % STRIP_RING_SLOTS] = value;
+    written.store(position + 1, std::memory_order_release);
+  }
+
+  unsigned int pop() {
+    std::uint64_t position = read.load(std::memory_order_relaxed);
+    while (written.load(std::memory_order_acquire) == position) {
+      std::this_thread::yield();
+    }
+    unsigned int value = slots[position % STRIP_RING_SLOTS];
+    read.store(position + 1, std::memory_order_release);
+    return value;
+  }
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "strip channels need lock-free atomics");
+
+// Measurements from one run of iceberg_avoiding_strips.
+struct strip_stats {
+  unsigned processes = 0;
+  double seconds = 0;
+
+  // Bytes of count row held by the widest worker.
+  size_t worker_count_bytes = 0;
+};
+
+// The work of one strip process: columns [first, end) of every row, with
+// counts arriving from the left on in (unless first is 0) and leaving to
+// the right on out (unless end is the last column). Returns the count of
+// the strip's bottom-right cell.
+unsigned int run_strip_worker(const grid& setting, coordinate first, coordinate end,
+                              strip_channel* in, strip_channel* out) {
+  assert(first % GRID_WORD_BITS == 0);
+  std::vector<unsigned int> counts(end - first, 0);
+  if (first == 0) {
+    counts[0] = 1;
+  }
+  for (coordinate r = 0; r < setting.rows(); ++r) {
+    unsigned int from_left = in ? in->pop() : 0;
+    // Shifting the row pointer makes column first the strip's column 0.
+    unsigned int leaving = advance_count_range(setting.row_words(r) + first / GRID_WORD_BITS,
+                                               counts.data(), 0, end - first, from_left);
+    if (out) {
+      out->push(leaving);
+    }
+  }
+  return counts.back();
+}
+
+// Solve the iceberg avoiding problem with one process per strip of
+// columns. get_grid is called in each worker process to obtain the grid;
+// processes of 0 means one per hardware thread. Throws std::runtime_error
+// if a worker cannot be started or fails.
+template <typename GetGrid>
+unsigned int iceberg_avoiding_strips(GetGrid&& get_grid, coordinate columns,
+                                     unsigned processes, strip_stats* stats) {
+  auto start = std::chrono::steady_clock::now();
+  if (processes == 0) {
+    processes = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // Strips are whole words wide.
+  const coordinate words = words_per_row(columns);
+  processes = unsigned(std::min<coordinate>(processes, words));
+  std::vector<coordinate> bounds(processes + 1);
+  for (unsigned k = 0; k <= processes; ++k) {
+    bounds[k] = std::min(columns, words * k / processes * GRID_WORD_BITS);
+  }
+
+  // Shared memory: the result, then one channel per pair of neighbours.
+  struct shared_header {
+    alignas(64) unsigned int result;
+  };
+  const size_t bytes = sizeof(shared_header) + (processes - 1) * sizeof(strip_channel);
+  void* memory = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    throw std::runtime_error("cannot map shared memory for strip workers");
+  }
+  std::unique_ptr<void, std::function<void(void*)>> unmap(memory, [bytes](void* p) {
+    ::munmap(p, bytes);
+  });
+  auto* header = new (memory) shared_header{0};
+  auto* channels = reinterpret_cast<strip_channel*>(static_cast<char*>(memory) + sizeof(shared_header));
+  for (unsigned k = 0; k + 1 < processes; ++k) {
+    auto* channel = new (&channels[k]) strip_channel;
+    channel->written.store(0);
+    channel->read.store(0);
+  }
+
+  std::vector<pid_t> workers;
+  auto stop_workers = [&]() {
+    for (pid_t pid : workers) {
+      ::kill(pid, SIGKILL);
+      ::waitpid(pid, nullptr, 0);
+    }
+  };
+  for (unsigned k = 0; k < processes; ++k) {
+    pid_t pid = ::fork();
+    if (pid < 0) {
+      stop_workers();
+      throw std::runtime_error("cannot start strip worker");
+    }
+    if (pid == 0) {
+      // Worker mode. _exit skips the parent's destructors and atexit
+      // handlers, which belong to the parent alone.
+      int status = 0;
+      try {
+        const grid& setting = get_grid();
+        unsigned int count = run_strip_worker(setting, bounds[k], bounds[k + 1],
+                                              (k > 0) ? &channels[k - 1] : nullptr,
+                                              (k + 1 < processes) ? &channels[k] : nullptr);
+        if (k + 1 == processes) {
+          header->result = count;
+        }
+      } catch (...) {
+        status = 1;
+      }
+      ::_exit(status);
+    }
+    workers.push_back(pid);
+  }
+
+  // Wait for every worker. If one fails, its neighbours would wait for it
+  // forever, so stop them all.
+  while (!workers.empty()) {
+    for (size_t i = 0; i < workers.size(); ) {
+      int status;
+      pid_t pid = ::waitpid(workers[i], &status, WNOHANG);
+      if (pid == 0) {
+        ++i;
+        continue;
+      }
+      workers.erase(workers.begin() + i);
+      if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        stop_workers();
+        throw std::runtime_error("strip worker failed");
+      }
+    }
+    if (!workers.empty()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  if (stats) {
+    stats->processes = processes;
+    stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats->worker_count_bytes = 0;
+    for (unsigned k = 0; k < processes; ++k) {
+      stats->worker_count_bytes = std::max(stats->worker_count_bytes,
+                                           (bounds[k + 1] - bounds[k]) * sizeof(unsigned int));
+    }
+  }
+  return header->result;
+}
+
+// Solve a grid already in memory with strip processes. The workers share
+// the grid with the parent without copying it.
+unsigned int iceberg_avoiding_strips(const grid& setting, unsigned processes = 0,
+                                     strip_stats* stats = nullptr) {
+  return iceberg_avoiding_strips([&]() -> const grid& { return setting; },
+                                 setting.columns(), processes, stats);
+}
+
+// Solve a binary grid file with strip processes. Each worker maps the file
+// itself, and only reads the pages holding its own strip.
+unsigned int iceberg_avoiding_strips(const std::string& filename, unsigned processes = 0,
+                                     strip_stats* stats = nullptr) {
+  const coordinate columns = map_binary_grid(filename).columns();
+  std::unique_ptr<grid> mapped;
+  return iceberg_avoiding_strips([&]() -> const grid& {
+    mapped.reset(new grid(map_binary_grid(filename)));
+    return *mapped;
+  }, columns, processes, stats);
+}
+
+}
@@ -7,11 +7,51 @@
 
 #include <cassert>
 #include <random>
+#include <sstream>
 
 #include "rubrictest.hpp"
 
 #include "ices_types.hpp"
 #include "ices_algs.hpp"
+#include "ices_bands.hpp"
+#include "ices_batch.hpp"
+#include "ices_crossings.hpp"
+#include "ices_disjoint.hpp"
+#include "ices_dynamic.hpp"
+#include "ices_exact.hpp"
+#include "ices_fixed.hpp"
+#include "ices_heatmap.hpp"
+#include "ices_io.hpp"
+#include "ices_mincost.hpp"
+#include "ices_moves.hpp"
+#include "ices_oblivious.hpp"
+#include "ices_paths.hpp"
+#include "ices_planner.hpp"
+#include "ices_prune.hpp"
+#include "ices_queries.hpp"
+#include "ices_random.hpp"
+#include "ices_shared.hpp"
+#include "ices_sparse.hpp"
+#include "ices_strips.hpp"
+
+// The small fixtures below, solved by the compiler.
+constexpr ices::fixed_grid<4, 4> fixed_empty4;
+constexpr ices::fixed_grid<4, 4> fixed_horizontal({"...X",
+                                                   "....",
+                                                   "....",
+                                                   "...."});
+constexpr ices::fixed_grid<4, 4> fixed_maze({"..XX",
+                                             "X..X",
+                                             "XX..",
+                                             "XXX."});
+static_assert(ices::iceberg_avoiding_fixed(fixed_empty4) == 20, "empty4");
+static_assert(ices::iceberg_avoiding_fixed(fixed_horizontal) == 19, "horizontal");
+static_assert(ices::iceberg_avoiding_fixed(fixed_maze) == 1, "maze");
+static_assert(ices::iceberg_avoiding_fixed(ices::fixed_grid<1, 1>()) == 1, "one cell");
+// C(68, 34) modulo 2^32, past the range of unsigned int.
+static_assert(ices::iceberg_avoiding_fixed(ices::fixed_grid<35, 35>()) == 2536228580u,
+              "wrapping");
+static_assert(ices::iceberg_avoiding_fixed(ices::fixed_grid<2, 100>()) == 100, "two words");
 
 int main() {
 
@@ -75,6 +115,20 @@ int main() {
       TEST_EQUAL("correct", maze_solution, iceberg_avoiding_exhaustive(maze));
     });
   
+  rubric.criterion("parallel exhaustive search", 2, [&]() {
+      ices::work_stealing_pool one(1), four(4);
+      TEST_EQUAL("empty4", empty4_solution, iceberg_avoiding_exhaustive_parallel(empty4, 3, four));
+      TEST_EQUAL("horizontal", horizontal_solution, iceberg_avoiding_exhaustive_parallel(horizontal, 0, four));
+      TEST_EQUAL("vertical", vertical_solution, iceberg_avoiding_exhaustive_parallel(vertical, 6, four));
+      TEST_EQUAL("all_ices", all_ices_solution, iceberg_avoiding_exhaustive_parallel(all_ices, 2, one));
+      TEST_EQUAL("maze", maze_solution, iceberg_avoiding_exhaustive_parallel(maze, 4, one));
+      for (size_t prefix = 0; prefix <= 9; prefix += 3) {
+        TEST_EQUAL("medium prefix " + std::to_string(prefix),
+                   iceberg_avoiding_dyn_prog(medium_random),
+                   iceberg_avoiding_exhaustive_parallel(medium_random, prefix, four));
+      }
+    });
+
   rubric.criterion("dynamic programming - simple cases", 4, [&]() {
       TEST_EQUAL("empty2", empty2_solution, iceberg_avoiding_dyn_prog(empty2));
       TEST_EQUAL("empty4", empty4_solution, iceberg_avoiding_dyn_prog(empty4));
@@ -101,6 +155,1143 @@ int main() {
       TEST_EQUAL("large", 1098385592, large_output);
     });
 
+  rubric.criterion("streaming from text and binary files", 2, [&]() {
+      const std::string text_file = "ices_test_grid.txt",
+                        binary_file = "ices_test_grid.bin";
+      for (auto* setting : {&empty2, &horizontal, &vertical, &all_ices, &maze,
+                            &small_random, &medium_random, &large_random}) {
+        auto expected = iceberg_avoiding_dyn_prog(*setting);
+        ices::write_text_grid(*setting, text_file);
+        ices::write_binary_grid(*setting, binary_file);
+        ices::stream_stats stats;
+        TEST_EQUAL("text", expected, ices::iceberg_avoiding_streaming(text_file, &stats));
+        TEST_EQUAL("text rows", setting->rows(), stats.rows);
+        TEST_EQUAL("text columns", setting->columns(), stats.columns);
+        TEST_EQUAL("binary", expected, ices::iceberg_avoiding_streaming(binary_file));
+      }
+
+      // Taller than several blocks of rows, so both buffers are cycled.
+      // With an iceberg at (10000, 0) a path must move right in one of the
+      // first 10000 rows.
+      ices::grid tall(20000, 2);
+      ices::write_binary_grid(tall, binary_file);
+      TEST_EQUAL("tall", 20000, ices::iceberg_avoiding_streaming(binary_file));
+      tall.set(10000, 0, ices::CELL_ICEBERG);
+      ices::write_text_grid(tall, text_file);
+      TEST_EQUAL("tall blocked", 10000, ices::iceberg_avoiding_streaming(text_file));
+
+      std::remove(text_file.c_str());
+      std::remove(binary_file.c_str());
+    });
+
+  rubric.criterion("grid file formats and mapped views", 2, [&]() {
+      const std::string binary_file = "ices_test_grid.bin",
+                        rle_file = "ices_test_grid.rle",
+                        text_file = "ices_test_grid.txt";
+      for (auto* setting : {&empty2, &vertical, &all_ices, &maze,
+                            &small_random, &large_random}) {
+        ices::write_binary_grid(*setting, binary_file);
+        ices::write_rle_grid(*setting, rle_file);
+        auto mapped = ices::map_binary_grid(binary_file);
+        TEST_TRUE("mapped is a view", mapped.is_view());
+        TEST_EQUAL("mapped cells", setting->printable(), mapped.printable());
+        TEST_EQUAL("mapped count", iceberg_avoiding_dyn_prog(*setting),
+                   iceberg_avoiding_dyn_prog(mapped));
+        TEST_EQUAL("rle cells", setting->printable(), ices::load_grid(rle_file).printable());
+        TEST_EQUAL("rle stream", iceberg_avoiding_dyn_prog(*setting),
+                   ices::iceberg_avoiding_streaming(rle_file));
+
+        // text -> rle -> binary -> text round trip through the row copier.
+        ices::write_text_grid(*setting, text_file);
+        auto text_reader = ices::open_row_reader(text_file);
+        auto rle_writer = ices::open_row_writer(rle_file, text_reader->columns());
+        ices::copy_rows(*text_reader, *rle_writer);
+        auto rle_reader = ices::open_row_reader(rle_file);
+        auto binary_writer = ices::open_row_writer(binary_file, rle_reader->columns());
+        ices::copy_rows(*rle_reader, *binary_writer);
+        TEST_EQUAL("round trip", setting->printable(), ices::load_grid(binary_file).printable());
+      }
+
+      // Copies of a view share the mapping, which outlives the original.
+      ices::write_binary_grid(maze, binary_file);
+      auto copy = [&]() {
+        auto mapped = ices::map_binary_grid(binary_file);
+        return mapped;
+      }();
+      TEST_EQUAL("copy of view", maze_solution, iceberg_avoiding_dyn_prog(copy));
+
+      // A mapped file with bits set past the last column is rejected,
+      // since a view cannot mask them.
+      ices::write_binary_grid(ices::grid(3, 5), binary_file);
+      {
+        std::fstream file(binary_file, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(sizeof(ices::binary_grid_header) + sizeof(ices::grid_word));
+        ices::grid_word stray = ices::grid_word(1) << 40;
+        file.write(reinterpret_cast<const char*>(&stray), sizeof(stray));
+      }
+      TEST_EQUAL("streamed padding", ices::grid(3, 5).printable(),
+                 ices::load_grid(binary_file).printable());
+      bool threw = false;
+      try {
+        ices::map_binary_grid(binary_file);
+      } catch (const std::runtime_error&) {
+        threw = true;
+      }
+      TEST_TRUE("mapped padding", threw);
+
+      // A run-length gap so large that adding it would wrap the column
+      // back inside the row is rejected, not decoded into the wrong cells.
+      {
+        std::ofstream out(rle_file, std::ios::binary | std::ios::trunc);
+        ices::rle_grid_header header;
+        std::memcpy(header.magic, ices::RLE_GRID_MAGIC, sizeof(header.magic));
+        header.rows = 1;
+        header.columns = 10;
+        header.reserved = 0;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        // Two runs: gap 2, length 1, then gap 2^64 - 2, length 1.
+        const unsigned char row[] = {2, 2, 1, 0xfe, 0xff, 0xff, 0xff, 0xff,
+                                     0xff, 0xff, 0xff, 0xff, 0x01, 1};
+        out.write(reinterpret_cast<const char*>(row), sizeof(row));
+      }
+      threw = false;
+      try {
+        ices::load_grid(rle_file);
+      } catch (const std::runtime_error&) {
+        threw = true;
+      }
+      TEST_TRUE("wrapping gap", threw);
+
+      std::remove(binary_file.c_str());
+      std::remove(rle_file.c_str());
+      std::remove(text_file.c_str());
+    });
+
+  rubric.criterion("sparse and parallel random grids", 2, [&]() {
+      ices::work_stealing_pool one(1), four(4);
+      auto count_icebergs = [](const ices::grid& setting) {
+        size_t count = 0;
+        for (ices::coordinate r = 0; r < setting.rows(); ++r) {
+          for (ices::coordinate c = 0; c < setting.columns(); ++c) {
+            count += (setting.get(r, c) == ices::CELL_ICEBERG);
+          }
+        }
+        return count;
+      };
+      struct shape { ices::coordinate rows, columns, icebergs; };
+      for (auto s : {shape{1, 1, 0}, shape{1, 5, 3}, shape{7, 1, 5}, shape{30, 70, 21},
+                     shape{30, 70, 1000}, shape{30, 70, 2098}, shape{200, 130, 2600}}) {
+        auto name = std::to_string(s.rows) + "x" + std::to_string(s.columns) +
+                    " with " + std::to_string(s.icebergs);
+        auto a = ices::random_grid(s.rows, s.columns, s.icebergs, 42, one),
+             b = ices::random_grid(s.rows, s.columns, s.icebergs, 42, four);
+        TEST_EQUAL(name + " deterministic", a.printable(), b.printable());
+        TEST_EQUAL(name + " count", s.icebergs, count_icebergs(a));
+        TEST_EQUAL(name + " start", ices::CELL_WATER, a.get(0, 0));
+        TEST_EQUAL(name + " goal", ices::CELL_WATER, a.get(s.rows - 1, s.columns - 1));
+      }
+      TEST_NOT_EQUAL("seeds differ", ices::random_grid(30, 70, 100, 1).printable(),
+                     ices::random_grid(30, 70, 100, 2).printable());
+
+      auto a = ices::random_grid_density(300, 300, 0.3, 9, one),
+           b = ices::random_grid_density(300, 300, 0.3, 9, four);
+      TEST_EQUAL("density deterministic", a.printable(), b.printable());
+      auto icebergs = count_icebergs(a);
+      TEST_TRUE("density near 30%", icebergs > 26000 && icebergs < 28000);
+      TEST_EQUAL("density goal", ices::CELL_WATER, a.get(299, 299));
+      TEST_EQUAL("density 1", 300 * 300 - 2, count_icebergs(ices::random_grid_density(300, 300, 1, 9)));
+    });
+
+  rubric.criterion("path unranking and enumeration", 2, [&]() {
+      for (auto* setting : {&empty2, &empty4, &horizontal, &vertical, &all_ices, &maze,
+                            &small_random}) {
+        // Every valid path, found by filtering all bitmasks; bit k set
+        // means step k goes right.
+        const size_t steps = setting->rows() + setting->columns() - 2;
+        std::vector<std::vector<ices::step_direction>> expected;
+        for (size_t bits = 0; bits < (size_t(1) << steps); ++bits) {
+          ices::path candidate(*setting);
+          std::vector<ices::step_direction> directions;
+          for (size_t k = 0; k < steps; ++k) {
+            auto dir = ((bits >> k) & 1) ? ices::STEP_DIRECTION_RIGHT : ices::STEP_DIRECTION_DOWN;
+            if (!candidate.is_step_valid(dir)) {
+              break;
+            }
+            candidate.add_step(dir);
+            directions.push_back(dir);
+          }
+          if (directions.size() == steps) {
+            expected.push_back(directions);
+          }
+        }
+        std::sort(expected.begin(), expected.end());
+
+        ices::suffix_counts counts(*setting);
+        TEST_EQUAL("total", iceberg_avoiding_dyn_prog(*setting), counts.total());
+        std::vector<std::vector<ices::step_direction>> listed;
+        for (ices::path_enumerator it(counts); !it.done(); it.next()) {
+          listed.push_back(it.steps());
+          TEST_EQUAL("current", it.steps().size() + 1, it.current().steps().size());
+        }
+        TEST_EQUAL("enumerated in order", expected, listed);
+        for (ices::path_count k = 0; k < counts.total(); ++k) {
+          TEST_EQUAL("unrank", expected[k], ices::unrank_steps(counts, k));
+          TEST_TRUE("unrank path", ices::unrank_path(counts, k) ==
+                                   ices::path(*setting, expected[k]));
+          ices::path_enumerator page(counts, k);
+          TEST_EQUAL("page start", expected[k], page.steps());
+        }
+        TEST_TRUE("past the end", ices::path_enumerator(counts, counts.total()).done());
+      }
+
+      ices::suffix_counts large_counts(large_random);
+      TEST_EQUAL("large total mod 2^32", iceberg_avoiding_dyn_prog(large_random),
+                 unsigned(large_counts.total()));
+      ices::grid huge(60, 60);
+      ices::suffix_counts huge_counts(huge);
+      TEST_EQUAL("saturates", ices::PATH_COUNT_MAX, huge_counts.total());
+      auto last = ices::unrank_steps(huge_counts, ices::PATH_COUNT_MAX - 1);
+      TEST_EQUAL("saturated unrank length", size_t(118), last.size());
+    });
+
+  rubric.criterion("uniform random path sampling", 2, [&]() {
+      ices::work_stealing_pool one(1), four(4);
+      for (auto* setting : {&empty4, &horizontal, &vertical, &maze, &small_random,
+                            &medium_random}) {
+        ices::suffix_counts counts(*setting);
+        ices::path_sampler sampler(*setting);
+        TEST_TRUE("any path", sampler.any_path());
+        const size_t samples = 4000;
+        auto a = sampler.sample_batch(samples, 11, 0, one),
+             b = sampler.sample_batch(samples, 11, 0, four);
+        TEST_EQUAL("deterministic", a, b);
+
+        // Every sample is valid; for grids with few paths, each path should
+        // be drawn about equally often.
+        const auto words = ices::words_per_path(*setting);
+        std::vector<size_t> hits(std::min<ices::path_count>(counts.total(), 100), 0);
+        for (size_t i = 0; i < samples; ++i) {
+          auto drawn = ices::unpack_path(*setting, &a[i * words]);
+          TEST_EQUAL("reaches goal", setting->rows() - 1, drawn.final_row());
+          TEST_EQUAL("reaches goal", setting->columns() - 1, drawn.final_column());
+          std::vector<ices::step_direction> steps;
+          for (size_t k = 1; k < drawn.steps().size(); ++k) {
+            steps.push_back(drawn.steps()[k].direction());
+          }
+          auto rank = ices::rank_steps(counts, steps);
+          if (rank < hits.size()) {
+            ++hits[rank];
+          }
+        }
+        if (counts.total() <= 20) {
+          double expected = double(samples) / counts.total();
+          for (auto h : hits) {
+            TEST_TRUE("uniform", std::abs(h - expected) < 5 * std::sqrt(expected) + 1);
+          }
+        }
+      }
+
+      TEST_FALSE("no path", ices::path_sampler(all_ices).any_path());
+
+      // Counts here have hundreds of digits; an empty square grid is
+      // symmetric, so the first step goes right half the time.
+      ices::grid wide(1000, 1000);
+      ices::path_sampler wide_sampler(wide);
+      ices::counter_rng gen(5, 0);
+      size_t right_first = 0;
+      for (int i = 0; i < 2000; ++i) {
+        auto drawn = wide_sampler.sample(gen);
+        TEST_EQUAL("wide goal", 999, drawn.final_row());
+        right_first += (drawn.steps()[1].direction() == ices::STEP_DIRECTION_RIGHT);
+      }
+      TEST_TRUE("wide symmetric", right_first > 900 && right_first < 1100);
+    });
+
+  rubric.criterion("path-through heat maps", 2, [&]() {
+      ices::work_stealing_pool one(1), four(4);
+      for (auto* setting : {&empty4, &horizontal, &vertical, &all_ices, &maze,
+                            &small_random, &medium_random}) {
+        // Count the paths through each cell by listing every path.
+        ices::suffix_counts counts(*setting);
+        std::vector<std::vector<double>> through(setting->rows(),
+                                                 std::vector<double>(setting->columns(), 0));
+        for (ices::path_enumerator it(counts); !it.done(); it.next()) {
+          ices::coordinate r = 0, c = 0;
+          through[0][0] += 1;
+          for (auto dir : it.steps()) {
+            (dir == ices::STEP_DIRECTION_RIGHT) ? ++c : ++r;
+            through[r][c] += 1;
+          }
+        }
+        double total = counts.total();
+        for (auto* pool : {&one, &four}) {
+          auto map = ices::path_through_map(*setting, *pool);
+          for (ices::coordinate r = 0; r < setting->rows(); ++r) {
+            for (ices::coordinate c = 0; c < setting->columns(); ++c) {
+              TEST_TRUE("fraction", std::abs(map[r][c] * total - through[r][c]) < 1e-6 * (total + 1));
+            }
+          }
+        }
+        size_t used_cells = 0;
+        for (auto& line : through) {
+          used_cells += std::count_if(line.begin(), line.end(), [](double n) { return n > 0; });
+        }
+        auto top = ices::top_path_through_cells(*setting, 5, four);
+        TEST_EQUAL("top count", std::min<size_t>(5, used_cells), top.size());
+        for (size_t i = 0; i < top.size(); ++i) {
+          TEST_TRUE("top value", std::abs(top[i].fraction * total -
+                                          through[top[i].row][top[i].column]) < 1e-6 * total);
+          if (i > 0) {
+            TEST_GE("top order", top[i - 1].fraction, top[i].fraction);
+          }
+        }
+      }
+
+      // Counts far beyond double range; every anti-diagonal of a grid is
+      // crossed exactly once by each path, so each sums to 1. The segments
+      // of rows are cycled many times.
+      auto big = ices::random_grid(700, 600, 700 * 600 / 20, 8);
+      std::vector<double> diagonals(700 + 600 - 1, 0.0);
+      ices::path_through_rows(big, [&](ices::coordinate r, const double* fractions) {
+        for (ices::coordinate c = 0; c < 600; ++c) {
+          diagonals[r + c] += fractions[c];
+        }
+      }, four);
+      for (double d : diagonals) {
+        TEST_TRUE("diagonal sums to 1", std::abs(d - 1) < 1e-9);
+      }
+
+      const std::string heat_file = "ices_test_heat.bin";
+      ices::write_path_through_map(maze, heat_file);
+      std::ifstream in(heat_file, std::ios::binary);
+      char magic[8];
+      std::uint64_t shape[2];
+      std::vector<float> cells(16);
+      in.read(magic, 8);
+      in.read(reinterpret_cast<char*>(shape), sizeof(shape));
+      in.read(reinterpret_cast<char*>(cells.data()), 16 * sizeof(float));
+      TEST_TRUE("heat file", in && shape[0] == 4 && shape[1] == 4);
+      TEST_EQUAL("heat file start", 1.0f, cells[0]);
+      TEST_EQUAL("heat file iceberg", 0.0f, cells[2]);
+      TEST_EQUAL("heat file goal", 1.0f, cells[15]);
+      in.close();
+      std::remove(heat_file.c_str());
+    });
+
+  rubric.criterion("dynamic updates with transfer matrices", 2, [&]() {
+      // Reference count for grids of any height, one row at a time.
+      auto rolling_count = [](const ices::grid& setting) {
+        std::vector<unsigned int> counts(setting.columns(), 0);
+        counts[0] = 1;
+        for (ices::coordinate r = 0; r < setting.rows(); ++r) {
+          ices::advance_count_row(setting.row_words(r), counts.data(), setting.columns());
+        }
+        return counts.back();
+      };
+
+      for (auto* setting : {&empty2, &empty4, &horizontal, &vertical, &all_ices, &maze,
+                            &small_random, &medium_random}) {
+        ices::dynamic_path_counter counter(*setting, 3);
+        TEST_EQUAL("initial", iceberg_avoiding_dyn_prog(*setting), counter.count());
+      }
+
+      std::mt19937 toggle_gen(3);
+      struct shape { ices::coordinate rows, columns, leaf_rows; };
+      for (auto s : {shape{1, 1, 1}, shape{50, 1, 4}, shape{1, 64, 16}, shape{90, 13, 1},
+                     shape{300, 64, 16}, shape{1000, 40, 7}}) {
+        ices::grid setting = ices::random_grid(s.rows, s.columns, s.rows * s.columns / 10, s.rows);
+        ices::dynamic_path_counter counter(setting, s.leaf_rows);
+        TEST_EQUAL("built", rolling_count(setting), counter.count());
+        if (s.rows * s.columns == 1) {
+          continue;
+        }
+        for (int i = 0; i < 60; ++i) {
+          ices::coordinate r = toggle_gen() % s.rows, c = toggle_gen() % s.columns;
+          if (r == 0 && c == 0) {
+            continue;
+          }
+          counter.toggle(r, c);
+          setting.set(r, c, (setting.get(r, c) == ices::CELL_WATER) ? ices::CELL_ICEBERG
+                                                                    : ices::CELL_WATER);
+          TEST_EQUAL("after toggle", rolling_count(setting), counter.count());
+        }
+        TEST_EQUAL("same grid", setting.printable(), counter.setting().printable());
+      }
+    });
+
+  rubric.criterion("checkpointed what-if variants", 2, [&]() {
+      ices::work_stealing_pool four(4);
+      std::mt19937 variant_gen(17);
+      struct shape { ices::coordinate rows, columns, interval; };
+      for (auto s : {shape{1, 9, 0}, shape{12, 25, 5}, shape{40, 90, 0}, shape{99, 60, 1},
+                     shape{100, 100, 100}}) {
+        auto base = ices::random_grid(s.rows, s.columns, s.rows * s.columns / 8, s.columns);
+        ices::variant_solver solver(base, s.interval);
+        TEST_EQUAL("base", iceberg_avoiding_dyn_prog(base), solver.base_count());
+        TEST_EQUAL("no changes", solver.base_count(), solver.count({}));
+
+        std::vector<std::vector<ices::cell_change>> variants;
+        std::vector<unsigned int> expected;
+        for (int v = 0; v < 40; ++v) {
+          ices::grid modified = base;
+          std::vector<ices::cell_change> changes;
+          // A few cells near each other, sometimes one far away.
+          ices::coordinate near_row = variant_gen() % s.rows;
+          for (int k = 0; k < 1 + v % 4; ++k) {
+            ices::coordinate r = (k == 3) ? variant_gen() % s.rows
+                                          : std::min(s.rows - 1, near_row + variant_gen() % 3),
+                             c = variant_gen() % s.columns;
+            if (r == 0 && c == 0) {
+              continue;
+            }
+            auto kind = (variant_gen() % 2) ? ices::CELL_ICEBERG : ices::CELL_WATER;
+            changes.push_back(ices::cell_change{r, c, kind});
+            modified.set(r, c, kind);
+          }
+          variants.push_back(changes);
+          expected.push_back(iceberg_avoiding_dyn_prog(modified));
+          TEST_EQUAL("variant", expected.back(), solver.count(changes));
+        }
+        TEST_EQUAL("all variants", expected, solver.count_all(variants, four));
+      }
+    });
+
+  rubric.criterion("reachability pruning", 2, [&]() {
+      for (auto* setting : {&empty2, &empty4, &horizontal, &vertical, &all_ices, &maze,
+                            &small_random, &medium_random, &large_random}) {
+        TEST_EQUAL("count", iceberg_avoiding_dyn_prog(*setting), ices::iceberg_avoiding_pruned(*setting));
+      }
+
+      for (ices::coordinate columns : {1, 2, 63, 64, 65, 130, 200}) {
+        for (double density : {0.0, 0.2, 0.35, 0.5}) {
+          auto setting = ices::random_grid_density(70, columns, density, columns);
+          // A cell is live exactly when some path goes through it: it is
+          // reachable from (0, 0) and has a path to the goal.
+          ices::suffix_counts to_goal(setting);
+          std::vector<bool> reachable(70 * columns, false);
+          for (ices::coordinate r = 0; r < 70; ++r) {
+            for (ices::coordinate c = 0; c < columns; ++c) {
+              bool from_here = (r == 0 && c == 0) ||
+                               (r > 0 && reachable[(r - 1) * columns + c]) ||
+                               (c > 0 && reachable[r * columns + c - 1]);
+              reachable[r * columns + c] = from_here && setting.may_step(r, c);
+            }
+          }
+          ices::live_cells live(setting);
+          TEST_EQUAL("any path", to_goal.total() > 0, live.any_path());
+          for (ices::coordinate r = 0; r < 70; ++r) {
+            for (ices::coordinate c = 0; c < columns; ++c) {
+              bool expected = reachable[r * columns + c] && to_goal.at(r, c) > 0;
+              TEST_EQUAL("live", expected, live.is_live(r, c));
+              if (expected) {
+                TEST_TRUE("interval", live.first(r) <= c && c < live.end(r));
+              }
+            }
+          }
+
+          std::vector<unsigned int> counts(columns, 0);
+          counts[0] = 1;
+          for (ices::coordinate r = 0; r < 70; ++r) {
+            ices::advance_count_row(setting.row_words(r), counts.data(), columns);
+          }
+          TEST_EQUAL("pruned count", counts.back(), ices::iceberg_avoiding_pruned(setting));
+        }
+      }
+    });
+
+  rubric.criterion("batch solving", 2, [&]() {
+      ices::work_stealing_pool four(4);
+      std::vector<ices::grid> batch = {empty2, empty4, horizontal, vertical, all_ices, maze,
+                                       small_random, medium_random, large_random};
+      // Mixed shapes, on both sides of the lane width.
+      std::mt19937 shape_gen(11);
+      for (int i = 0; i < 300; ++i) {
+        ices::coordinate rows = 1 + shape_gen() % 100,
+                         columns = 1 + shape_gen() % ((i % 3 == 0) ? 100 : 64);
+        batch.push_back(ices::random_grid_density(rows, columns, 0.1 + (i % 4) * 0.1, i));
+      }
+      std::vector<unsigned int> expected;
+      for (auto& setting : batch) {
+        expected.push_back(iceberg_avoiding_dyn_prog(setting));
+      }
+      TEST_EQUAL("batch", expected, ices::iceberg_avoiding_batch(batch, four));
+      TEST_EQUAL("empty batch", std::vector<unsigned int>(),
+                 ices::iceberg_avoiding_batch(std::vector<ices::grid>(), four));
+
+      const std::string filename = "ices_test_grid.batch";
+      ices::write_grid_batch(batch, filename);
+      auto mapped = ices::map_grid_batch(filename);
+      TEST_EQUAL("batch file size", batch.size(), mapped.size());
+      bool same = mapped.size() == batch.size();
+      for (size_t i = 0; same && i < batch.size(); ++i) {
+        same = mapped[i].is_view() && mapped[i].printable() == batch[i].printable();
+      }
+      TEST_TRUE("batch file grids", same);
+      TEST_EQUAL("batch file", expected, ices::iceberg_avoiding_batch(filename, four));
+      std::remove(filename.c_str());
+    });
+
+  rubric.criterion("move sets and wavefront", 2, [&]() {
+      ices::work_stealing_pool four(4);
+      for (auto* setting : {&empty2, &empty4, &horizontal, &vertical, &all_ices, &maze,
+                            &small_random, &medium_random, &large_random}) {
+        auto expected = iceberg_avoiding_dyn_prog(*setting);
+        TEST_EQUAL("rolling", expected, ices::iceberg_avoiding_rolling(*setting));
+        TEST_EQUAL("wavefront", expected, ices::iceberg_avoiding_wavefront(*setting, four, 3));
+        TEST_EQUAL("masked right/down", expected,
+                   ices::count_move_paths<ices::right_down_moves>(
+                     *setting, ices::move_masks(setting->rows(), setting->columns())));
+      }
+
+      std::mt19937 mask_gen(5);
+      for (ices::coordinate rows : {1, 2, 5, 9}) {
+        for (ices::coordinate columns : {1, 3, 8}) {
+          auto setting = ices::random_grid(rows, columns, rows * columns / 5, rows + columns);
+          ices::move_masks masks(rows, columns);
+          for (ices::coordinate r = 0; r < rows; ++r) {
+            for (ices::coordinate c = 0; c < columns; ++c) {
+              masks.set_mask(r, c, mask_gen() | mask_gen());
+            }
+          }
+          TEST_EQUAL("diagonal",
+                     ices::count_move_paths_exhaustive<ices::diagonal_moves>(setting),
+                     ices::count_move_paths<ices::diagonal_moves>(setting));
+          TEST_EQUAL("knight",
+                     ices::count_move_paths_exhaustive<ices::knight_moves>(setting),
+                     ices::count_move_paths<ices::knight_moves>(setting));
+          TEST_EQUAL("down left",
+                     ices::count_move_paths_exhaustive<ices::down_left_moves>(setting),
+                     ices::count_move_paths<ices::down_left_moves>(setting));
+          TEST_EQUAL("masked knight",
+                     ices::count_move_paths_exhaustive<ices::knight_moves>(setting, masks),
+                     ices::count_move_paths<ices::knight_moves>(setting, masks));
+          for (ices::coordinate tile : {1, 2, 4}) {
+            TEST_EQUAL("knight wavefront",
+                       ices::count_move_paths<ices::knight_moves>(setting, masks),
+                       ices::count_move_paths_wavefront<ices::knight_moves>(setting, masks, four, tile));
+            TEST_EQUAL("diagonal wavefront",
+                       ices::count_move_paths<ices::diagonal_moves>(setting),
+                       ices::count_move_paths_wavefront<ices::diagonal_moves>(
+                         setting, ices::all_moves(), four, tile));
+          }
+        }
+      }
+
+      // Wide and tall grids, where many tiles run at once.
+      for (auto shape : {std::make_pair(300, 40), std::make_pair(40, 300), std::make_pair(257, 259)}) {
+        auto setting = ices::random_grid_density(shape.first, shape.second, 0.2, shape.first);
+        TEST_EQUAL("wide wavefront", ices::iceberg_avoiding_rolling(setting),
+                   ices::iceberg_avoiding_wavefront(setting, four, 16));
+        TEST_EQUAL("wide knight wavefront", ices::count_move_paths<ices::knight_moves>(setting),
+                   ices::count_move_paths_wavefront<ices::knight_moves>(
+                     setting, ices::all_moves(), four, 7));
+      }
+
+      auto p = ices::to_move_path(ices::path(maze, {ices::STEP_DIRECTION_RIGHT, ices::STEP_DIRECTION_DOWN}));
+      TEST_EQUAL("converted moves", std::vector<unsigned>({0, 1}), p.moves());
+      TEST_TRUE("diagonal step", ices::move_path<ices::diagonal_moves>(empty4, {2, 2, 2}).final_row() == 3);
+      TEST_FALSE("off the grid", ices::move_path<ices::down_left_moves>(empty4).is_step_valid(2));
+    });
+
+  rubric.criterion("minimum-cost paths", 2, [&]() {
+      ices::work_stealing_pool four(4);
+      for (ices::coordinate rows : {1, 2, 7, 30, 61}) {
+        for (ices::coordinate columns : {1, 5, 33, 70}) {
+          for (double density : {0.0, 0.2, 0.4}) {
+            auto setting = ices::random_weighted_grid(rows, columns, density, 9, rows * columns);
+            // The whole table, cell by cell.
+            std::vector<ices::path_cost> table(rows * columns, ices::PATH_COST_INFINITE);
+            for (ices::coordinate r = 0; r < rows; ++r) {
+              for (ices::coordinate c = 0; c < columns; ++c) {
+                if (setting.setting().get(r, c) == ices::CELL_ICEBERG) {
+                  continue;
+                }
+                ices::path_cost before = (r == 0 && c == 0) ? 0 : ices::PATH_COST_INFINITE;
+                if (r > 0) {
+                  before = std::min(before, table[(r - 1) * columns + c]);
+                }
+                if (c > 0) {
+                  before = std::min(before, table[r * columns + c - 1]);
+                }
+                if (before < ices::PATH_COST_INFINITE) {
+                  table[r * columns + c] = before + setting.cost(r, c);
+                }
+              }
+            }
+            auto expected = table.back();
+            TEST_EQUAL("cost", expected, ices::min_path_cost(setting));
+            for (ices::coordinate tile : {1, 4, 16}) {
+              TEST_EQUAL("wavefront cost", expected,
+                         ices::min_path_cost_wavefront(setting, four, tile));
+            }
+            if (expected < ices::PATH_COST_INFINITE) {
+              auto cheapest = ices::min_cost_path(setting, four);
+              TEST_EQUAL("path length", rows + columns - 1, cheapest.steps().size());
+              TEST_EQUAL("path end", rows - 1, cheapest.final_row());
+              TEST_EQUAL("path cost", expected, setting.cost_of(cheapest));
+            }
+          }
+        }
+      }
+
+      // Against every path of a small grid.
+      auto setting = ices::random_weighted_grid(8, 9, 0.15, 100, 3);
+      ices::suffix_counts counts(setting.setting());
+      ices::path_cost cheapest = ices::PATH_COST_INFINITE;
+      for (ices::path_enumerator it(counts); !it.done(); it.next()) {
+        cheapest = std::min(cheapest, setting.cost_of(it.current()));
+      }
+      TEST_EQUAL("every path", cheapest, ices::min_path_cost(setting));
+
+      // Large enough for the divide and conquer to fork.
+      auto large = ices::random_weighted_grid(600, 500, 0.1, 1000, 4);
+      auto expected = ices::min_path_cost(large);
+      TEST_EQUAL("large path cost", expected, large.cost_of(ices::min_cost_path(large, four)));
+      TEST_EQUAL("large wavefront", expected, ices::min_path_cost_wavefront(large, four, 64));
+    });
+
+  rubric.criterion("paths crossing up to k icebergs", 2, [&]() {
+      ices::work_stealing_pool four(4);
+      for (auto* setting : {&empty2, &empty4, &horizontal, &vertical, &all_ices, &maze,
+                            &small_random, &medium_random, &large_random}) {
+        auto expected = iceberg_avoiding_dyn_prog(*setting);
+        TEST_EQUAL("k=0", expected, ices::count_paths_crossing(*setting, 0));
+        TEST_EQUAL("k=0 wavefront", expected, ices::count_paths_crossing_wavefront(*setting, 0, four, 4));
+      }
+
+      // Every path of a small grid, by the number of icebergs it crosses.
+      std::function<void(const ices::grid&, ices::coordinate, ices::coordinate,
+                         ices::coordinate, std::vector<unsigned>&)> walk =
+        [&](const ices::grid& setting, ices::coordinate r, ices::coordinate c,
+            ices::coordinate crossed, std::vector<unsigned>& by_crossings) {
+          crossed += (setting.get(r, c) == ices::CELL_ICEBERG);
+          if (r == setting.rows() - 1 && c == setting.columns() - 1) {
+            by_crossings[crossed]++;
+            return;
+          }
+          if (c + 1 < setting.columns()) {
+            walk(setting, r, c + 1, crossed, by_crossings);
+          }
+          if (r + 1 < setting.rows()) {
+            walk(setting, r + 1, c, crossed, by_crossings);
+          }
+        };
+      for (ices::coordinate rows : {1, 3, 6}) {
+        for (ices::coordinate columns : {1, 4, 7}) {
+          auto setting = ices::random_grid_density(rows, columns, 0.35, rows * 10 + columns);
+          std::vector<unsigned> by_crossings(rows + columns, 0);
+          walk(setting, 0, 0, 0, by_crossings);
+          unsigned at_most = 0;
+          for (ices::coordinate k = 0; k < rows + columns; ++k) {
+            at_most += by_crossings[k];
+            TEST_EQUAL("at most k", at_most, ices::count_paths_crossing(setting, k));
+            for (ices::coordinate tile : {1, 2, 5}) {
+              TEST_EQUAL("at most k wavefront", at_most,
+                         ices::count_paths_crossing_wavefront(setting, k, four, tile));
+            }
+          }
+        }
+      }
+
+      auto large = ices::random_grid_density(300, 280, 0.3, 8);
+      for (ices::coordinate k : {0, 1, 5}) {
+        TEST_EQUAL("large wavefront", ices::count_paths_crossing(large, k),
+                   ices::count_paths_crossing_wavefront(large, k, four, 32));
+      }
+    });
+
+  rubric.criterion("cache-oblivious recursion", 2, [&]() {
+      ices::work_stealing_pool four(4);
+      for (auto* setting : {&empty2, &empty4, &horizontal, &vertical, &all_ices, &maze,
+                            &small_random, &medium_random, &large_random}) {
+        TEST_EQUAL("count", iceberg_avoiding_dyn_prog(*setting),
+                   ices::iceberg_avoiding_oblivious(*setting, four));
+      }
+      // Thin, square and uneven shapes, large enough to split and fork.
+      for (auto shape : {std::make_pair(1, 20000), std::make_pair(20000, 1),
+                         std::make_pair(3, 9000), std::make_pair(700, 701),
+                         std::make_pair(1023, 517), std::make_pair(90, 5000)}) {
+        for (double density : {0.0, 0.1, 0.3}) {
+          auto setting = ices::random_grid_density(shape.first, shape.second, density,
+                                                   shape.first + shape.second);
+          TEST_EQUAL("rectangle", ices::iceberg_avoiding_rolling(setting),
+                     ices::iceberg_avoiding_oblivious(setting, four));
+        }
+      }
+      // Blocks narrower than the four-row staircase, with an iceberg in
+      // each row and column in turn.
+      TEST_EQUAL("empty 10x2", 10u, ices::iceberg_avoiding_oblivious(ices::grid(10, 2), four));
+      TEST_EQUAL("empty 20000x2", 20000u,
+                 ices::iceberg_avoiding_oblivious(ices::grid(20000, 2), four));
+      for (ices::coordinate columns : {1, 2}) {
+        for (ices::coordinate row = 0; row < 9; ++row) {
+          for (ices::coordinate column = 0; column < columns; ++column) {
+            ices::grid setting(9, columns);
+            if (row == 0 && column == 0) {
+              continue;
+            }
+            setting.set(row, column, ices::CELL_ICEBERG);
+            TEST_EQUAL("narrow", ices::iceberg_avoiding_rolling(setting),
+                       ices::iceberg_avoiding_oblivious(setting, four));
+          }
+        }
+      }
+    });
+
+  rubric.criterion("multi-process strips", 2, [&]() {
+      for (auto* setting : {&empty2, &horizontal, &maze, &large_random}) {
+        TEST_EQUAL("count", iceberg_avoiding_dyn_prog(*setting),
+                   ices::iceberg_avoiding_strips(*setting, 3));
+      }
+      for (auto shape : {std::make_pair(300, 64), std::make_pair(257, 1000),
+                         std::make_pair(9000, 300), std::make_pair(40, 20000)}) {
+        auto setting = ices::random_grid_density(shape.first, shape.second, 0.15, shape.second);
+        auto expected = ices::iceberg_avoiding_rolling(setting);
+        for (unsigned processes : {1, 2, 3, 5}) {
+          ices::strip_stats stats;
+          TEST_EQUAL("strips", expected, ices::iceberg_avoiding_strips(setting, processes, &stats));
+          TEST_TRUE("processes", stats.processes >= 1 && stats.processes <= processes);
+          TEST_TRUE("count row split",
+                    stats.worker_count_bytes < shape.second * sizeof(unsigned int) ||
+                    stats.processes == 1);
+        }
+      }
+
+      const std::string filename = "ices_test_grid.bin";
+      auto setting = ices::random_grid_density(500, 3000, 0.1, 21);
+      ices::write_binary_grid(setting, filename);
+      TEST_EQUAL("file strips", ices::iceberg_avoiding_rolling(setting),
+                 ices::iceberg_avoiding_strips(filename, 4));
+      std::remove(filename.c_str());
+      bool threw = false;
+      try {
+        ices::iceberg_avoiding_strips(filename, 2);
+      } catch (const std::runtime_error&) {
+        threw = true;
+      }
+      TEST_TRUE("missing file", threw);
+    });
+
+  rubric.criterion("orientation and solver planning", 2, [&]() {
+      ices::work_stealing_pool four(4);
+      for (auto shape : {std::make_pair(1, 1), std::make_pair(3, 70), std::make_pair(64, 64),
+                         std::make_pair(130, 65), std::make_pair(200, 1000)}) {
+        auto setting = ices::random_grid_density(shape.first, shape.second, 0.2, shape.second);
+        auto transposed = ices::transpose_grid(setting, four);
+        TEST_EQUAL("transposed rows", setting.columns(), transposed.rows());
+        bool same = true;
+        for (ices::coordinate r = 0; r < setting.rows(); ++r) {
+          for (ices::coordinate c = 0; c < setting.columns(); ++c) {
+            same = same && setting.get(r, c) == transposed.get(c, r);
+          }
+        }
+        TEST_TRUE("transposed cells", same);
+        TEST_EQUAL("transposed twice", setting.printable(),
+                   ices::transpose_grid(transposed, four).printable());
+        TEST_EQUAL("transposed count", ices::iceberg_avoiding_rolling(setting),
+                   ices::iceberg_avoiding_rolling(transposed));
+      }
+
+      ices::binomial_table binomial(70);
+      TEST_EQUAL("C(10, 3)", 120u, binomial(10, 3));
+      // Pascal's triangle, modulo 2^32.
+      std::vector<unsigned> pascal_row(1, 1);
+      bool pascal = true;
+      for (ices::coordinate n = 0; n <= 70; ++n) {
+        for (ices::coordinate k = 0; k <= n; ++k) {
+          pascal = pascal && binomial(n, k) == pascal_row[k];
+        }
+        pascal_row.push_back(0);
+        for (ices::coordinate k = n + 1; k > 0; --k) {
+          pascal_row[k] += pascal_row[k - 1];
+        }
+      }
+      TEST_TRUE("Pascal's triangle", pascal);
+      for (auto* setting : {&empty2, &empty4, &horizontal, &vertical, &all_ices, &maze,
+                            &small_random, &medium_random, &large_random}) {
+        TEST_EQUAL("sparse", iceberg_avoiding_dyn_prog(*setting), ices::iceberg_avoiding_sparse(*setting));
+      }
+      for (ices::coordinate icebergs : {0, 1, 10, 300}) {
+        auto setting = ices::random_grid(700, 900, icebergs, icebergs);
+        TEST_EQUAL("sparse large", ices::iceberg_avoiding_rolling(setting),
+                   ices::iceberg_avoiding_sparse(setting));
+      }
+
+      TEST_EQUAL("few icebergs", ices::SOLVER_SPARSE,
+                 ices::plan_dp(1000, 1000, 100, true, 1).solver);
+      TEST_EQUAL("many workers", ices::SOLVER_WAVEFRONT,
+                 ices::plan_dp(10000, 10000, 10000000, true, 8).solver);
+      auto wide = ices::plan_dp(100, 100000000, 1000000000, true, 8);
+      TEST_EQUAL("wide", ices::SOLVER_ROLLING, wide.solver);
+      TEST_TRUE("wide transposed", wide.transpose);
+      TEST_FALSE("tall not transposed", ices::plan_dp(100000000, 100, 1000000000, true, 1).transpose);
+      ices::planner_limits small_memory;
+      small_memory.memory_bytes = 1000;
+      TEST_EQUAL("big file", ices::SOLVER_STREAMING,
+                 ices::plan_dp(0, 100000, 0, false, 1, true, 5000, small_memory).solver);
+
+      // Every kind of plan gives the same count.
+      std::ostringstream log;
+      auto wide_grid = ices::random_grid_density(40, 300000, 0.1, 3);
+      ices::planner_limits small_cache;
+      small_cache.cache_bytes = 1 << 16;
+      TEST_EQUAL("planned wide", ices::iceberg_avoiding_rolling(wide_grid),
+                 ices::iceberg_avoiding_planned(wide_grid, true, four, log, small_cache));
+      TEST_TRUE("verbose", log.str().find("transposed") != std::string::npos);
+      auto sparse_grid = ices::random_grid(500, 500, 40, 7);
+      TEST_EQUAL("planned sparse", ices::iceberg_avoiding_rolling(sparse_grid),
+                 ices::iceberg_avoiding_planned(sparse_grid, true, four, log));
+      TEST_TRUE("verbose sparse", log.str().find("sparse") != std::string::npos);
+      auto square = ices::random_grid_density(300, 300, 0.3, 5);
+      ices::planner_limits small_tiles;
+      small_tiles.wavefront_side = 100;
+      small_tiles.wavefront_cells = 10000;
+      TEST_EQUAL("planned wavefront", ices::iceberg_avoiding_rolling(square),
+                 ices::iceberg_avoiding_planned(square, true, four, log, small_tiles));
+      TEST_TRUE("verbose wavefront", log.str().find("wavefront") != std::string::npos);
+
+      const std::string filename = "ices_test_grid.bin";
+      ices::write_binary_grid(square, filename);
+      TEST_EQUAL("planned file", ices::iceberg_avoiding_rolling(square),
+                 ices::iceberg_avoiding_planned(filename, true, four, log));
+      TEST_EQUAL("streamed file", ices::iceberg_avoiding_rolling(square),
+                 ices::iceberg_avoiding_planned(filename, true, four, log, small_memory));
+      TEST_TRUE("verbose streaming", log.str().find("streaming") != std::string::npos);
+      std::remove(filename.c_str());
+    });
+
+  rubric.criterion("empty-band skipping", 2, [&]() {
+      ices::work_stealing_pool four(4);
+      for (auto* setting : {&empty2, &empty4, &horizontal, &vertical, &all_ices, &maze,
+                            &small_random, &medium_random, &large_random}) {
+        TEST_EQUAL("count", iceberg_avoiding_dyn_prog(*setting),
+                   ices::iceberg_avoiding_bands(*setting, four));
+      }
+
+      // Convolving with the band kernel is the same as stepping through
+      // the empty rows, by either method.
+      ices::binomial_table binomial(6000);
+      for (ices::coordinate width : {1, 2, 63, 64, 1000, 3000}) {
+        for (ices::coordinate height : {1, 2, 7, 2500}) {
+          std::vector<unsigned int> stepped(width), direct, transformed;
+          std::mt19937 gen(width + height);
+          for (auto& x : stepped) {
+            x = gen();
+          }
+          direct = transformed = stepped;
+          std::vector<ices::grid_word> empty_row(ices::words_per_row(width), 0);
+          for (ices::coordinate r = 0; r < height; ++r) {
+            ices::advance_count_row(empty_row.data(), stepped.data(), width);
+          }
+          auto kernel = ices::band_kernel(binomial, height, width);
+          ices::convolve_direct(direct.data(), kernel.data(), width);
+          ices::convolve_ntt(transformed.data(), kernel.data(), width, four);
+          TEST_TRUE("direct convolution", stepped == direct);
+          TEST_TRUE("NTT convolution", stepped == transformed);
+        }
+      }
+
+      for (auto shape : {std::make_pair(1, 1), std::make_pair(1000, 1),
+                         std::make_pair(1, 1000), std::make_pair(3000, 700),
+                         std::make_pair(500, 2000)}) {
+        for (double fraction : {0.0, 0.01, 0.2, 1.0}) {
+          auto setting = ices::random_banded_grid(shape.first, shape.second, 0.05, fraction,
+                                                  shape.first + shape.second);
+          auto expected = ices::iceberg_avoiding_rolling(setting);
+          for (auto method : {ices::BAND_AUTO, ices::BAND_ROWS, ices::BAND_DIRECT,
+                              ices::BAND_NTT}) {
+            TEST_EQUAL("banded", expected, ices::iceberg_avoiding_bands(setting, four, method));
+          }
+        }
+      }
+      ices::band_stats stats;
+      auto sparse_rows = ices::random_banded_grid(20000, 1000, 0.05, 0.001, 11);
+      TEST_EQUAL("sparse rows", ices::iceberg_avoiding_rolling(sparse_rows),
+                 ices::iceberg_avoiding_bands(sparse_rows, four, ices::BAND_AUTO, &stats));
+      TEST_TRUE("bands skipped", stats.bands > 0 && stats.rows_skipped > 15000);
+    });
+
+  rubric.criterion("path-count queries", 2, [&]() {
+      ices::work_stealing_pool four(4);
+      // Corner to corner is the whole problem.
+      for (auto* setting : {&empty2, &empty4, &horizontal, &vertical, &all_ices, &maze,
+                            &small_random, &medium_random, &large_random}) {
+        ices::path_query corners{0, 0, setting->rows() - 1, setting->columns() - 1};
+        TEST_EQUAL("corners", iceberg_avoiding_dyn_prog(*setting),
+                   ices::count_paths_between(*setting, corners));
+        TEST_EQUAL("corners batch", iceberg_avoiding_dyn_prog(*setting),
+                   ices::count_paths_between(*setting, std::vector<ices::path_query>{corners},
+                                             four)[0]);
+      }
+
+      // Random queries, some sharing sources and targets and some
+      // impossible, against one DP each.
+      for (auto shape : {std::make_pair(1, 300), std::make_pair(300, 1),
+                         std::make_pair(600, 400), std::make_pair(37, 2000)}) {
+        auto setting = ices::random_grid_density(shape.first, shape.second, 0.1,
+                                                 shape.first * shape.second);
+        std::mt19937 gen(shape.first + shape.second);
+        auto row = [&]() { return ices::coordinate(gen() % shape.first); };
+        auto column = [&]() { return ices::coordinate(gen() % shape.second); };
+        std::vector<ices::path_query> queries;
+        for (int i = 0; i < 300; ++i) {
+          queries.push_back({row(), column(), row(), column()});
+        }
+        for (int i = 0; i < 10; ++i) {
+          ices::coordinate r = row() / 2, c = column() / 2;
+          for (int j = 0; j < 20; ++j) {
+            queries.push_back({r, c, r + row() / 2, c + column() / 2});
+            queries.push_back({row() / 2, column() / 2, shape.first - 1 - r,
+                               shape.second - 1 - c});
+          }
+        }
+        auto answers = ices::count_paths_between(setting, queries, four);
+        bool same = true;
+        for (size_t i = 0; i < queries.size(); ++i) {
+          same = same && answers[i] == ices::count_paths_between(setting, queries[i]);
+        }
+        TEST_TRUE("batch matches single queries", same);
+      }
+      TEST_EQUAL("backwards", 0u, ices::count_paths_between(empty4, {3, 3, 0, 0}));
+      TEST_EQUAL("single cell", 1u, ices::count_paths_between(empty4, {2, 1, 2, 1}));
+      TEST_TRUE("no queries", ices::count_paths_between(empty4, {}, four).empty());
+    });
+
+  rubric.criterion("packed paths", 2, [&]() {
+      for (auto* setting : {&empty2, &empty4, &horizontal, &vertical, &maze,
+                            &small_random, &medium_random, &large_random}) {
+        ices::path_sampler sampler(*setting);
+        if (!sampler.any_path()) {
+          continue;
+        }
+        const auto steps = setting->rows() + setting->columns() - 2;
+        const auto words = ices::words_per_path(*setting);
+        auto batch = sampler.sample_batch(50, 21);
+        for (size_t i = 0; i < 50; ++i) {
+          ices::packed_path packed(*setting, &batch[i * words], steps);
+          auto unpacked = ices::unpack_path(*setting, &batch[i * words]);
+          TEST_EQUAL("final row", setting->rows() - 1, packed.final_row());
+          TEST_EQUAL("final column", setting->columns() - 1, packed.final_column());
+          TEST_TRUE("to path", packed.to_path() == unpacked);
+          TEST_TRUE("from path", ices::packed_path(unpacked) == packed);
+          TEST_FALSE("at goal", packed.is_step_valid(ices::STEP_DIRECTION_RIGHT) ||
+                                packed.is_step_valid(ices::STEP_DIRECTION_DOWN));
+        }
+      }
+
+      // Build a long path step by step, checking validity against path,
+      // then take it apart again.
+      auto wide = ices::random_grid_density(90, 400, 0.05, 22);
+      ices::path_sampler sampler(wide);
+      std::vector<std::uint64_t> words(ices::words_per_path(wide));
+      ices::counter_rng gen(22, 0);
+      sampler.sample_packed(gen, words.data());
+      auto full = ices::unpack_path(wide, words.data());
+      ices::path slow(wide);
+      ices::packed_path fast(wide);
+      bool same = true;
+      for (size_t k = 1; k < full.steps().size(); ++k) {
+        for (auto dir : {ices::STEP_DIRECTION_START, ices::STEP_DIRECTION_RIGHT,
+                         ices::STEP_DIRECTION_DOWN}) {
+          same = same && slow.is_step_valid(dir) == fast.is_step_valid(dir);
+        }
+        slow.add_step(full.steps()[k].direction());
+        fast.add_step(full.steps()[k].direction());
+        same = same && slow.final_row() == fast.final_row() &&
+               slow.final_column() == fast.final_column();
+      }
+      TEST_TRUE("steps agree", same);
+      TEST_TRUE("long path", fast.to_path() == full);
+      ices::packed_path copy = fast;
+      while (fast.size() > 0) {
+        fast.remove_last_step();
+      }
+      TEST_EQUAL("emptied", 0u, fast.final_row() + fast.final_column());
+      TEST_TRUE("emptied equals new", fast == ices::packed_path(wide));
+      TEST_TRUE("copy unchanged", copy.to_path() == full);
+
+      ices::packed_path short_path(empty4, {ices::STEP_DIRECTION_RIGHT,
+                                            ices::STEP_DIRECTION_DOWN});
+      TEST_EQUAL("short row", 1u, short_path.final_row());
+      TEST_EQUAL("short column", 1u, short_path.final_column());
+      TEST_EQUAL("step 0", ices::STEP_DIRECTION_RIGHT, short_path.step_at(0));
+      TEST_EQUAL("step 1", ices::STEP_DIRECTION_DOWN, short_path.step_at(1));
+    });
+
+  rubric.criterion("compile-time grids", 2, [&]() {
+      TEST_EQUAL("maze", maze_solution, ices::iceberg_avoiding_fixed(fixed_maze));
+      TEST_EQUAL("to grid", maze.printable(), fixed_maze.to_grid().printable());
+      TEST_EQUAL("from grid", vertical_solution,
+                 ices::iceberg_avoiding_fixed(ices::fixed_grid<4, 4>(vertical)));
+      for (std::uint64_t seed = 0; seed < 50; ++seed) {
+        auto small = ices::random_grid_density(9, 70, 0.2, seed);
+        ices::fixed_grid<9, 70> fixed(small);
+        TEST_EQUAL("random", ices::iceberg_avoiding_rolling(small),
+                   ices::iceberg_avoiding_fixed(fixed));
+      }
+    });
+
+  rubric.criterion("shared read-only grids", 2, [&]() {
+      const std::string filename = "ices_test_grid.bin";
+      for (auto shape : {std::make_pair(1, 1), std::make_pair(3, 70),
+                         std::make_pair(2000, 300), std::make_pair(40, 20000)}) {
+        auto setting = ices::random_grid_density(shape.first, shape.second, 0.1,
+                                                 shape.first + shape.second);
+        ices::write_binary_grid(setting, filename);
+        auto shared = ices::share_binary_grid(filename);
+        TEST_TRUE("view", shared.is_view());
+        TEST_EQUAL("same cells", setting.printable(), shared.printable());
+        auto expected = ices::iceberg_avoiding_rolling(setting);
+        for (size_t window : {size_t(1), size_t(4096), ices::PREFETCH_WINDOW_BYTES}) {
+          TEST_EQUAL("prefetched", expected, ices::iceberg_avoiding_prefetched(shared, window));
+        }
+        TEST_EQUAL("owned grid", expected, ices::iceberg_avoiding_prefetched(setting));
+        // Hints past the end, or on owned grids, are harmless.
+        ices::advise_rows(shared, shared.rows(), 10, MADV_WILLNEED);
+        ices::advise_rows(setting, 0, setting.rows(), MADV_WILLNEED);
+      }
+
+      // A child process sees the same shared pages.
+      auto setting = ices::random_grid_density(500, 500, 0.2, 9);
+      ices::write_binary_grid(setting, filename);
+      auto shared = ices::share_binary_grid(filename);
+      auto expected = ices::iceberg_avoiding_rolling(setting);
+      pid_t pid = ::fork();
+      if (pid == 0) {
+        ::_exit(ices::iceberg_avoiding_prefetched(shared) == expected ? 0 : 1);
+      }
+      int status = -1;
+      ::waitpid(pid, &status, 0);
+      TEST_TRUE("child count", pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+      std::remove(filename.c_str());
+      bool threw = false;
+      try {
+        ices::share_binary_grid(filename);
+      } catch (const std::runtime_error&) {
+        threw = true;
+      }
+      TEST_TRUE("missing file", threw);
+    });
+
+  rubric.criterion("exact counts by CRT", 2, [&]() {
+      ices::work_stealing_pool four(4);
+      TEST_EQUAL("zero", "0", ices::big_count().to_string());
+      ices::big_count two_64(std::uint64_t(1) << 63);
+      two_64 += ices::big_count(std::uint64_t(1) << 63);
+      TEST_EQUAL("2^64", "18446744073709551616", two_64.to_string());
+      TEST_EQUAL("2^64 bits", 65u, two_64.bits());
+      TEST_EQUAL("largest primes", (std::vector<std::uint32_t>{2147483647u, 2147483629u,
+                                                               2147483587u}),
+                 ices::crt_primes(3));
+
+      // Residues of a known big number rebuild it.
+      ices::big_count value(1);
+      for (std::uint32_t k = 1; k <= 60; ++k) {
+        value.multiply_add(4000000000u - k, k);
+      }
+      auto primes = ices::crt_primes(ices::CRT_LANES * 8);
+      std::vector<std::uint32_t> residues;
+      for (auto p : primes) {
+        ices::big_count copy = value;
+        residues.push_back(copy.divide(p));
+      }
+      TEST_TRUE("reconstruct", ices::crt_reconstruct(residues, primes) == value);
+
+      for (auto* setting : {&empty2, &empty4, &horizontal, &vertical, &all_ices, &maze,
+                            &small_random, &medium_random, &large_random}) {
+        auto exact = ices::iceberg_avoiding_exact(*setting, four);
+        TEST_EQUAL("modulo 2^32", iceberg_avoiding_dyn_prog(*setting), exact.low32());
+        TEST_TRUE("big-integer DP", exact == ices::iceberg_avoiding_bigint(*setting));
+      }
+      // C(100, 50).
+      TEST_EQUAL("empty 51x51", "100891344545564193334812497256",
+                 ices::iceberg_avoiding_exact(ices::grid(51, 51), four).to_string());
+      for (auto shape : {std::make_pair(1, 500), std::make_pair(500, 1),
+                         std::make_pair(300, 200), std::make_pair(20, 3000)}) {
+        for (double density : {0.0, 0.05, 0.3}) {
+          auto setting = ices::random_grid_density(shape.first, shape.second, density, 25);
+          auto exact = ices::iceberg_avoiding_exact(setting, four);
+          TEST_EQUAL("rolling", ices::iceberg_avoiding_rolling(setting), exact.low32());
+          TEST_TRUE("big-integer", exact == ices::iceberg_avoiding_bigint(setting));
+          TEST_TRUE("within bound", exact.bits() <=
+                    size_t(ices::log2_path_bound(shape.first, shape.second)) + 1);
+        }
+      }
+    });
+
+  rubric.criterion("disjoint paths by LGV determinants", 2, [&]() {
+      ices::work_stealing_pool four(4);
+      ices::big_integer a(123456789012345), b(-98765432109876);
+      ices::big_integer product = a * b;
+      TEST_EQUAL("product", "-12193263113702045407560419220", product.to_string());
+      TEST_TRUE("divide by odd", ices::divide_exact(product, b) == a);
+      TEST_TRUE("divide by even", ices::divide_exact(product, a) == b);
+      TEST_TRUE("difference", (a - b).to_string() == "222222221122221" &&
+                              (b - a) == -(a - b) && (a - a).is_zero());
+      TEST_EQUAL("residue", 2147483647u - 98765432109876u % 2147483647u, b.residue(2147483647u));
+
+      std::vector<ices::big_integer> swapped = {0, 1, 1, 0}, square = {2, 3, 4, 5};
+      TEST_EQUAL("pivot swap", "-1", ices::determinant_bareiss(swapped, 2).to_string());
+      TEST_EQUAL("2x2", "-2", ices::determinant_bareiss(square, 2).to_string());
+      TEST_EQUAL("2x2 mod", ices::LGV_PRIME - 2,
+                 ices::determinant_mod({2, 3, 4, 5}, 2, ices::LGV_PRIME));
+
+      // Against the exhaustive oracle, endpoints anywhere, so that some
+      // permutations other than the identity have disjoint tuples too.
+      std::mt19937 endpoints(31);
+      for (int trial = 0; trial < 60; ++trial) {
+        auto setting = ices::grid::random(5, 6, trial % 7, endpoints);
+        const size_t k = 1 + trial % 4;
+        std::vector<ices::grid_cell> sources, sinks;
+        for (size_t i = 0; i < k; ++i) {
+          sources.push_back({endpoints() % 3, endpoints() % 4});
+          sinks.push_back({2 + endpoints() % 3, 2 + endpoints() % 4});
+        }
+        long long expected = ices::count_disjoint_paths_exhaustive(setting, sources, sinks);
+        auto exact = ices::count_disjoint_paths_exact(setting, sources, sinks, four);
+        TEST_TRUE("exact", exact == ices::big_integer(expected));
+        TEST_EQUAL("mod p", exact.residue(ices::LGV_PRIME),
+                   ices::count_disjoint_paths_mod(setting, sources, sinks, ices::LGV_PRIME, four));
+        TEST_EQUAL("small prime", exact.residue(1000003),
+                   ices::count_disjoint_paths_mod(setting, sources, sinks, 1000003, four));
+      }
+
+      // Convoys from the top row to the bottom row can only pair source i
+      // with sink i, so the determinant counts them.
+      for (size_t k = 1; k <= 4; ++k) {
+        std::vector<ices::grid_cell> sources, sinks;
+        for (size_t i = 0; i < k; ++i) {
+          sources.push_back({0, i});
+          sinks.push_back({5, 6 - k + i});
+        }
+        auto setting = ices::grid::random(6, 7, 5, endpoints);
+        long long expected = ices::count_disjoint_paths_exhaustive(setting, sources, sinks);
+        TEST_TRUE("convoy count", expected >= 0 &&
+                  ices::count_disjoint_paths_exact(setting, sources, sinks, four) ==
+                  ices::big_integer(expected));
+      }
+
+      // One source and sink is an ordinary query.
+      auto one = ices::count_disjoint_paths_exact(large_random, {{1, 2}}, {{18, 70}}, four);
+      TEST_EQUAL("k = 1", ices::count_paths_between(large_random, ices::path_query{1, 2, 18, 70}),
+                 one.magnitude.low32());
+
+      // Larger convoys: exact and modular agree, including more sources
+      // than one lane group holds.
+      auto setting = ices::random_grid_density(300, 400, 0.02, 32);
+      for (size_t k : {3, 8, 11}) {
+        std::vector<ices::grid_cell> sources, sinks;
+        for (size_t i = 0; i < k; ++i) {
+          sources.push_back({0, 5 * i});
+          sinks.push_back({299, 399 - 5 * (k - 1 - i)});
+        }
+        auto exact = ices::count_disjoint_paths_exact(setting, sources, sinks, four);
+        TEST_FALSE("non-negative", exact.negative);
+        TEST_EQUAL("mod p", exact.residue(ices::LGV_PRIME),
+                   ices::count_disjoint_paths_mod(setting, sources, sinks, ices::LGV_PRIME, four));
+      }
+    });
+
   rubric.criterion("stress test", 2,[&]() {
       const ices::coordinate ROWS = 5,
 	MAX_COLUMNS = 15;
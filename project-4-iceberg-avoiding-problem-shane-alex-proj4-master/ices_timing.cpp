@@ -5,21 +5,559 @@
 // elapsed times precisely. You should modify this program to gather
 // all of your experimental data.
 //
+// Usage: ices_timing [--large-files]
+//        ices_timing sweep [OPTIONS]
+//
+// With no arguments, runs a fixed report of every algorithm;
+// --large-files adds a 10^10-cell grid to the file loading section, which
+// writes a 1.25 GB file to the working directory, and runs the shared grid
+// section on a 250 MB file instead of a 50 MB one. With sweep,
+// times the chosen solvers over every combination of size, aspect ratio,
+// density and seed, and writes one CSV line per combination; run
+// "ices_timing sweep --help" for the options.
+//
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <fstream>
+#include <functional>
+#include <new>
 #include <random>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 #include "timer.hpp"
 
 #include "ices_algs.hpp"
+#include "ices_bands.hpp"
+#include "ices_batch.hpp"
+#include "ices_crossings.hpp"
+#include "ices_disjoint.hpp"
+#include "ices_dynamic.hpp"
+#include "ices_exact.hpp"
+#include "ices_fixed.hpp"
+#include "ices_heatmap.hpp"
+#include "ices_io.hpp"
+#include "ices_mincost.hpp"
+#include "ices_moves.hpp"
+#include "ices_oblivious.hpp"
+#include "ices_paths.hpp"
+#include "ices_planner.hpp"
+#include "ices_prune.hpp"
+#include "ices_queries.hpp"
+#include "ices_random.hpp"
+#include "ices_shared.hpp"
+#include "ices_strips.hpp"
+
+// RIGHT and DOWN as an ordinary move set, which goes through the generic
+// counting kernel rather than the specialized one.
+struct generic_right_down_moves {
+  static constexpr ices::grid_move MOVES[] = {{0, 1}, {1, 0}};
+};
 
 void print_bar() {
   std::cout << std::string(79, '-') << std::endl;
 }
 
-int main() {
+// Write a rows x columns binary grid file with about 1/8 of the cells
+// icebergs, one row at a time.
+void write_random_binary_grid(const std::string& filename,
+                              ices::coordinate rows, ices::coordinate columns,
+                              std::mt19937_64& gen) {
+  ices::binary_row_writer writer(filename, columns);
+  std::vector<ices::grid_word> row(ices::words_per_row(columns));
+  for (ices::coordinate r = 0; r < rows; ++r) {
+    for (auto& word : row) {
+      word = gen() & gen() & gen();
+    }
+    if (columns % ices::GRID_WORD_BITS != 0) {
+      row.back() &= (ices::grid_word(1) << (columns % ices::GRID_WORD_BITS)) - 1;
+    }
+    if (r == 0) {
+      row[0] &= ~ices::grid_word(1);
+    }
+    writer.write_row(row.data());
+  }
+  writer.close();
+}
+
+// Stream grids of several shapes from disk, reporting throughput and the
+// solver's buffer memory, which should track the number of columns only.
+void time_streaming() {
+  const std::string filename = "ices_timing_grid.bin";
+  std::mt19937_64 gen;
+  for (ices::coordinate columns : {1000, 10000}) {
+    for (ices::coordinate rows : {1000, 10000}) {
+      write_random_binary_grid(filename, rows, columns, gen);
+      ices::stream_stats stats;
+      auto output = ices::iceberg_avoiding_streaming(filename, &stats);
+      std::cout << "rows=" << rows << ", columns=" << columns
+                << ": paths=" << output
+                << ", " << stats.cells_per_second() << " cells/second"
+                << ", buffers=" << stats.buffer_bytes << " bytes" << std::endl;
+    }
+  }
+  std::remove(filename.c_str());
+}
+
+// Count the icebergs in a grid a word at a time, touching every row.
+size_t count_icebergs(const ices::grid& setting) {
+  size_t count = 0;
+  for (ices::coordinate r = 0; r < setting.rows(); ++r) {
+    auto* row = setting.row_words(r);
+    for (ices::coordinate w = 0; w < ices::words_per_row(setting.columns()); ++w) {
+      count += __builtin_popcountll(row[w]);
+    }
+  }
+  return count;
+}
+
+// Time loading a rows x columns grid saved in the given format, both by
+// copying it into memory and, for binary files, by mapping it in place.
+void time_loading(const std::string& filename, ices::coordinate rows,
+                  ices::coordinate columns, std::mt19937_64& gen) {
+  {
+    // Roughly 1% icebergs, so the run-length format has something to gain.
+    std::vector<ices::grid_word> row(ices::words_per_row(columns));
+    auto writer = ices::open_row_writer(filename, columns);
+    for (ices::coordinate r = 0; r < rows; ++r) {
+      std::fill(row.begin(), row.end(), 0);
+      for (ices::coordinate k = 0; k < columns / 100; ++k) {
+        auto c = gen() % columns;
+        row[c / ices::GRID_WORD_BITS] |= ices::grid_word(1) << (c % ices::GRID_WORD_BITS);
+      }
+      row[0] &= (r == 0) ? ~ices::grid_word(1) : ~ices::grid_word(0);
+      writer->write_row(row.data());
+    }
+    writer->close();
+  }
+
+  Timer timer;
+  std::cout << filename << ", " << double(rows) * columns << " cells" << std::endl;
+  if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".bin") == 0) {
+    timer.reset();
+    auto mapped = ices::map_binary_grid(filename);
+    double map_elapsed = timer.elapsed();
+    auto icebergs = count_icebergs(mapped);
+    std::cout << "  map=" << map_elapsed << " seconds"
+              << ", map+scan=" << timer.elapsed() << " seconds"
+              << " (" << icebergs << " icebergs)" << std::endl;
+  }
+  timer.reset();
+  auto loaded = ices::load_grid(filename);
+  double load_elapsed = timer.elapsed();
+  auto icebergs = count_icebergs(loaded);
+  std::cout << "  copy=" << load_elapsed << " seconds"
+            << ", copy+scan=" << timer.elapsed() << " seconds"
+            << " (" << icebergs << " icebergs)" << std::endl;
+  std::remove(filename.c_str());
+}
+
+// A solver the sweep can run. applies returns nullptr when the solver
+// can run on a rows x columns grid, or else the reason it is skipped.
+struct sweep_solver {
+  std::string name;
+  std::function<unsigned int(const ices::grid&)> run;
+  std::function<const char*(ices::coordinate rows, ices::coordinate columns,
+                            size_t icebergs)> applies;
+};
+
+// Options for a sweep, with their defaults.
+struct sweep_options {
+  std::vector<ices::coordinate> sizes{100, 1000};
+  std::vector<double> aspects{1.0};
+  std::vector<double> densities{0.1};
+  std::vector<std::uint64_t> seeds{1};
+  std::vector<std::string> solvers{"rolling", "wavefront", "oblivious", "planned"};
+  unsigned warmup = 1, repeats = 5;
+  ices::coordinate exhaustive_max = 30;
+  std::string csv;
+};
+
+void print_sweep_usage(std::ostream& out, const std::vector<sweep_solver>& solvers) {
+  out << "usage: ices_timing [--large-files]\n"
+      << "       ices_timing sweep [OPTIONS]\n"
+      << "\n"
+      << "  --n LIST          sizes n = rows + columns; a comma-separated list, or\n"
+      << "                    FROM:TO[:FACTOR] for a geometric range (factor 2)\n"
+      << "  --aspect LIST     rows / columns ratios (1)\n"
+      << "  --density LIST    fractions of cells that are icebergs (0.1)\n"
+      << "  --seeds LIST      random seeds; a list, or FROM:TO (1)\n"
+      << "  --solvers LIST    solvers to time, or \"all\" (rolling,wavefront,\n"
+      << "                    oblivious,planned)\n"
+      << "  --warmup K        untimed runs before timing (1)\n"
+      << "  --repeat K        timed runs; the median is reported (5)\n"
+      << "  --exhaustive-max N  largest n for exhaustive solvers (30)\n"
+      << "  --csv FILE        write the CSV to FILE instead of standard output\n"
+      << "\n"
+      << "solvers:";
+  for (const auto& solver : solvers) {
+    out << " " << solver.name;
+  }
+  out << std::endl;
+}
+
+// The solvers, with the limits each needs. exhaustive_max bounds rows +
+// columns for the exhaustive searches.
+std::vector<sweep_solver> sweep_solvers(ices::coordinate exhaustive_max) {
+  auto any = [](ices::coordinate, ices::coordinate, size_t) -> const char* { return nullptr; };
+  auto exhaustive = [exhaustive_max](ices::coordinate rows, ices::coordinate columns,
+                                      size_t) -> const char* {
+    return (rows + columns > exhaustive_max) ? "n above --exhaustive-max" : nullptr;
+  };
+  return {
+    {"exhaustive", [](const ices::grid& g) { return iceberg_avoiding_exhaustive(g); },
+     exhaustive},
+    {"exhaustive_parallel",
+     [](const ices::grid& g) { return iceberg_avoiding_exhaustive_parallel(g); }, exhaustive},
+    {"dyn_prog", [](const ices::grid& g) { return iceberg_avoiding_dyn_prog(g); },
+     [](ices::coordinate rows, ices::coordinate columns, size_t) -> const char* {
+       // Its table is fixed at 100 x 100.
+       return (rows > 100 || columns > 100) ? "grid larger than 100x100" : nullptr;
+     }},
+    {"rolling", [](const ices::grid& g) { return ices::iceberg_avoiding_rolling(g); }, any},
+    {"wavefront", [](const ices::grid& g) { return ices::iceberg_avoiding_wavefront(g); }, any},
+    {"oblivious", [](const ices::grid& g) { return ices::iceberg_avoiding_oblivious(g); }, any},
+    {"pruned", [](const ices::grid& g) { return ices::iceberg_avoiding_pruned(g); }, any},
+    {"bands", [](const ices::grid& g) { return ices::iceberg_avoiding_bands(g); }, any},
+    {"sparse", [](const ices::grid& g) { return ices::iceberg_avoiding_sparse(g); },
+     [](ices::coordinate rows, ices::coordinate columns, size_t icebergs) -> const char* {
+       // O(k^2) pair updates; allow up to ten times the cell count.
+       return (double(icebergs) * icebergs / 2 > 10.0 * rows * columns)
+              ? "too many icebergs" : nullptr;
+     }},
+    {"planned", [](const ices::grid& g) { return ices::iceberg_avoiding_planned(g); }, any},
+    {"strips", [](const ices::grid& g) { return ices::iceberg_avoiding_strips(g); }, any},
+  };
+}
+
+// Split a comma-separated list.
+std::vector<std::string> split_list(const std::string& text, char separator = ',') {
+  std::vector<std::string> items;
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, separator)) {
+    items.push_back(item);
+  }
+  if (items.empty()) {
+    throw std::invalid_argument("empty list");
+  }
+  return items;
+}
+
+template <typename T>
+T parse_value(const std::string& text) {
+  std::istringstream stream(text);
+  T value;
+  if (!(stream >> value) || !stream.eof()) {
+    throw std::invalid_argument("cannot parse \"" + text + "\"");
+  }
+  return value;
+}
+
+template <typename T>
+std::vector<T> parse_list(const std::string& text) {
+  std::vector<T> values;
+  for (const auto& item : split_list(text)) {
+    values.push_back(parse_value<T>(item));
+  }
+  return values;
+}
+
+// A list, or FROM:TO[:STEP] where step multiplies (geometric) or adds
+// (linear).
+std::vector<std::uint64_t> parse_range(const std::string& text, bool geometric) {
+  if (text.find(':') == std::string::npos) {
+    return parse_list<std::uint64_t>(text);
+  }
+  auto parts = split_list(text, ':');
+  if (parts.size() > 3) {
+    throw std::invalid_argument("bad range \"" + text + "\"");
+  }
+  std::uint64_t from = parse_value<std::uint64_t>(parts[0]),
+                to = parse_value<std::uint64_t>(parts[1]);
+  double step = (parts.size() == 3) ? parse_value<double>(parts[2]) : (geometric ? 2.0 : 1.0);
+  if (from > to || (geometric ? step <= 1.0 : step < 1.0) ||
+      (geometric && from == 0)) {
+    throw std::invalid_argument("bad range \"" + text + "\"");
+  }
+  std::vector<std::uint64_t> values;
+  for (double x = from; x <= to + 1e-9; x = geometric ? x * step : x + step) {
+    values.push_back(std::uint64_t(std::llround(x)));
+  }
+  values.erase(std::unique(values.begin(), values.end()), values.end());
+  return values;
+}
+
+// Read a field in kB, such as VmRSS or VmHWM, from /proc/self/status, or
+// another file in the same format such as /proc/self/smaps_rollup; 0
+// where that is unavailable.
+size_t process_memory_kb(const std::string& field,
+                         const std::string& file = "/proc/self/status") {
+  std::ifstream status(file);
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, field.size() + 1, field + ":") == 0) {
+      std::istringstream value(line.substr(field.size() + 1));
+      size_t kb = 0;
+      value >> kb;
+      return kb;
+    }
+  }
+  return 0;
+}
+
+// Start a new memory high-water mark at the current resident size, after
+// handing freed heap memory back to the system so that earlier runs do not
+// count. Silently does nothing where unsupported.
+void reset_peak_memory() {
+#ifdef __GLIBC__
+  malloc_trim(0);
+#endif
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5" << std::flush;
+}
+
+double median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  const size_t half = values.size() / 2;
+  return (values.size() % 2 == 1) ? values[half] : (values[half - 1] + values[half]) / 2;
+}
+
+// Run a sweep, writing CSV to out and progress to std::cerr. Returns the
+// number of counts that disagreed between solvers.
+size_t run_sweep(const sweep_options& options, std::ostream& out) {
+  auto all = sweep_solvers(options.exhaustive_max);
+  std::vector<const sweep_solver*> chosen;
+  for (const auto& name : options.solvers) {
+    bool found = false;
+    for (const auto& solver : all) {
+      if (name == "all" || name == solver.name) {
+        chosen.push_back(&solver);
+        found = true;
+      }
+    }
+    if (!found) {
+      throw std::invalid_argument("unknown solver \"" + name + "\"");
+    }
+  }
+
+  out << "solver,n,rows,columns,aspect,density,seed,icebergs,repeats,median_seconds,"
+         "min_seconds,cells_per_second,rss_kb,peak_rss_kb,count" << std::endl;
+  size_t mismatches = 0;
+  Timer timer;
+  for (auto n : options.sizes) {
+    for (double aspect : options.aspects) {
+      // rows / columns = aspect with rows + columns = n, leaving at least
+      // one of each.
+      const ices::coordinate rows = std::min<ices::coordinate>(
+                                        n - 1, std::max<ices::coordinate>(
+                                                   1, std::llround(n * aspect / (1 + aspect)))),
+                             columns = n - rows;
+      for (double density : options.densities) {
+        for (auto seed : options.seeds) {
+          auto setting = ices::random_grid_density(rows, columns, density, seed);
+          const size_t icebergs = ices::iceberg_count(setting);
+          bool have_reference = false;
+          unsigned int reference = 0;
+          for (const auto* solver : chosen) {
+            if (const char* reason = solver->applies(rows, columns, icebergs)) {
+              std::cerr << "skipping " << solver->name << " on " << rows << "x" << columns
+                        << ": " << reason << std::endl;
+              continue;
+            }
+            unsigned int count = 0;
+            for (unsigned k = 0; k < options.warmup; ++k) {
+              count = solver->run(setting);
+            }
+            reset_peak_memory();
+            const size_t rss = process_memory_kb("VmRSS");
+            std::vector<double> seconds;
+            for (unsigned k = 0; k < options.repeats; ++k) {
+              timer.reset();
+              count = solver->run(setting);
+              seconds.push_back(timer.elapsed());
+            }
+            const size_t peak = process_memory_kb("VmHWM");
+            if (!have_reference) {
+              reference = count;
+              have_reference = true;
+            } else if (count != reference) {
+              std::cerr << "MISMATCH: " << solver->name << " counts " << count << " on "
+                        << rows << "x" << columns << " seed " << seed << ", expected "
+                        << reference << std::endl;
+              ++mismatches;
+            }
+            const double middle = median(seconds);
+            out << solver->name << "," << n << "," << rows << "," << columns << ","
+                << aspect << "," << density << "," << seed << "," << icebergs << ","
+                << options.repeats << "," << middle << ","
+                << *std::min_element(seconds.begin(), seconds.end()) << ","
+                << double(rows) * columns / middle << "," << rss << "," << peak << ","
+                << count << std::endl;
+          }
+        }
+      }
+    }
+  }
+  return mismatches;
+}
+
+// Parse the options after "sweep". Returns false if help was asked for.
+bool parse_sweep_options(int argc, char* argv[], sweep_options& options) {
+  for (int i = 2; i < argc; ++i) {
+    const std::string flag = argv[i];
+    if (flag == "--help" || flag == "-h") {
+      return false;
+    }
+    if (i + 1 == argc) {
+      throw std::invalid_argument("missing value for " + flag);
+    }
+    const std::string value = argv[++i];
+    if (flag == "--n") {
+      auto sizes = parse_range(value, true);
+      options.sizes.assign(sizes.begin(), sizes.end());
+    } else if (flag == "--aspect") {
+      options.aspects = parse_list<double>(value);
+    } else if (flag == "--density") {
+      options.densities = parse_list<double>(value);
+    } else if (flag == "--seeds") {
+      options.seeds = parse_range(value, false);
+    } else if (flag == "--solvers") {
+      options.solvers = split_list(value);
+    } else if (flag == "--warmup") {
+      options.warmup = parse_value<unsigned>(value);
+    } else if (flag == "--repeat") {
+      options.repeats = parse_value<unsigned>(value);
+    } else if (flag == "--exhaustive-max") {
+      options.exhaustive_max = parse_value<ices::coordinate>(value);
+    } else if (flag == "--csv") {
+      options.csv = value;
+    } else {
+      throw std::invalid_argument("unknown option " + flag);
+    }
+  }
+  for (auto n : options.sizes) {
+    if (n < 2) {
+      throw std::invalid_argument("n must be at least 2");
+    }
+  }
+  for (double aspect : options.aspects) {
+    if (!(aspect > 0)) {
+      throw std::invalid_argument("aspect ratios must be positive");
+    }
+  }
+  for (double density : options.densities) {
+    if (!(density >= 0 && density <= 1)) {
+      throw std::invalid_argument("densities must be between 0 and 1");
+    }
+  }
+  if (options.repeats == 0) {
+    throw std::invalid_argument("--repeat must be at least 1");
+  }
+  return true;
+}
+
+// Run processes analysis processes at once on one large binary grid
+// file, each either loading its own copy or mapping the file shared, and
+// report their startup time, DP time and memory. Rss counts every page a
+// process has mapped; Pss divides shared pages among the processes sharing
+// them, so the Pss values add up to the memory actually used.
+void time_shared_grids(const std::string& filename, unsigned processes, bool shared) {
+  // Workers finish their DPs, then wait for measure so that all of them
+  // read their memory with every process's pages mapped.
+  struct alignas(64) control {
+    std::atomic<bool> measure;
+  };
+  struct alignas(64) report {
+    std::atomic<bool> computed, measured;
+    double startup, seconds;
+    size_t rss_kb, pss_kb;
+  };
+  const size_t bytes = sizeof(control) + processes * sizeof(report);
+  void* memory = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    throw std::runtime_error("cannot map shared memory");
+  }
+  auto* go = new (memory) control;
+  go->measure.store(false);
+  auto* reports = reinterpret_cast<report*>(static_cast<char*>(memory) + sizeof(control));
+  for (unsigned k = 0; k < processes; ++k) {
+    new (&reports[k]) report;
+    reports[k].computed.store(false);
+    reports[k].measured.store(false);
+  }
+
+  std::vector<pid_t> workers;
+  for (unsigned k = 0; k < processes; ++k) {
+    pid_t pid = ::fork();
+    if (pid == 0) {
+      Timer timer;
+      ices::grid setting = shared ? ices::share_binary_grid(filename) : ices::load_grid(filename);
+      reports[k].startup = timer.elapsed();
+      timer.reset();
+      volatile unsigned int count = shared ? ices::iceberg_avoiding_prefetched(setting)
+                                           : ices::iceberg_avoiding_rolling(setting);
+      (void) count;
+      reports[k].seconds = timer.elapsed();
+      reports[k].computed.store(true);
+      while (!go->measure.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      reports[k].rss_kb = process_memory_kb("Rss", "/proc/self/smaps_rollup");
+      reports[k].pss_kb = process_memory_kb("Pss", "/proc/self/smaps_rollup");
+      reports[k].measured.store(true);
+      ::pause();
+      ::_exit(0);
+    }
+    workers.push_back(pid);
+  }
+  auto wait_for = [&](std::atomic<bool> report::*flag) {
+    for (unsigned k = 0; k < processes; ++k) {
+      while (!(reports[k].*flag).load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  };
+  wait_for(&report::computed);
+  go->measure.store(true);
+  wait_for(&report::measured);
+  for (pid_t pid : workers) {
+    ::kill(pid, SIGKILL);
+    ::waitpid(pid, nullptr, 0);
+  }
+
+  double startup = 0, seconds = 0;
+  size_t rss = 0, pss = 0;
+  for (unsigned k = 0; k < processes; ++k) {
+    startup += reports[k].startup / processes;
+    seconds += reports[k].seconds / processes;
+    rss += reports[k].rss_kb;
+    pss += reports[k].pss_kb;
+  }
+  std::cout << processes << " processes, " << (shared ? "shared mapping" : "private copies")
+            << ": startup " << startup << " seconds, DP " << seconds
+            << " seconds, total Rss " << rss / 1024 << " MB, total Pss " << pss / 1024
+            << " MB" << std::endl;
+  ::munmap(memory, bytes);
+}
+
+int run_report(bool large_files) {
 
   const size_t EXHAUSTIVE_OPTIM_MAX_N = 30;
 
@@ -58,6 +596,19 @@ int main() {
     std::cout << std::endl << "elapsed time=" << elapsed << " seconds" << std::endl;
   }
 
+  print_bar();
+  std::cout << "parallel exhaustive optimization" << std::endl;
+  if (n > EXHAUSTIVE_OPTIM_MAX_N) {
+    std::cout << std::endl << "(n too large, skipping exhaustive optimization)" << std::endl;
+  } else {
+    timer.reset();
+    auto parallel_output = iceberg_avoiding_exhaustive_parallel(input);
+    elapsed = timer.elapsed();
+    std::cout << "Parallel exhaustive: " << parallel_output
+              << " (" << ices::default_pool().size() << " workers)" << std::endl;
+    std::cout << std::endl << "elapsed time=" << elapsed << " seconds" << std::endl;
+  }
+
   print_bar();
   std::cout << "dynamic programming" << std::endl;
   timer.reset();
@@ -66,7 +617,658 @@ int main() {
   std::cout << "Dynamic programming" << dyn_prog_output << std::endl;
   std::cout << std::endl << "elapsed time=" << elapsed << " seconds" << std::endl;
 
+  print_bar();
+  std::cout << "streaming dynamic programming" << std::endl;
+  time_streaming();
+
+  print_bar();
+  std::cout << "grid file loading" << std::endl;
+  {
+    std::mt19937_64 load_gen;
+    time_loading("ices_timing_grid.txt", 10000, 10000, load_gen);
+    time_loading("ices_timing_grid.rle", 10000, 10000, load_gen);
+    time_loading("ices_timing_grid.bin", 10000, 10000, load_gen);
+    if (large_files) {
+      // 10^10 cells: 1.25 GB on disk in the binary format.
+      time_loading("ices_timing_grid.bin", 100000, 100000, load_gen);
+    }
+  }
+
+  print_bar();
+  std::cout << "listing every valid path" << std::endl;
+  {
+    std::mt19937 list_gen;
+    ices::grid setting = ices::grid::random(10, 11, 11, list_gen);
+    const size_t steps = setting.rows() + setting.columns() - 2;
+
+    timer.reset();
+    size_t filtered = 0;
+    for (size_t bits = 0; bits < (size_t(1) << steps); ++bits) {
+      ices::path candidate(setting);
+      size_t k = 0;
+      for (; k < steps; ++k) {
+        auto dir = ((bits >> k) & 1) ? ices::STEP_DIRECTION_RIGHT : ices::STEP_DIRECTION_DOWN;
+        if (!candidate.is_step_valid(dir)) {
+          break;
+        }
+        candidate.add_step(dir);
+      }
+      filtered += (k == steps);
+    }
+    std::cout << "filtered exhaustive: " << filtered << " paths, "
+              << timer.elapsed() << " seconds" << std::endl;
+
+    timer.reset();
+    ices::suffix_counts counts(setting);
+    size_t listed = 0;
+    for (ices::path_enumerator it(counts); !it.done(); it.next()) {
+      listed += (it.current().final_row() == setting.rows() - 1);
+    }
+    std::cout << "lazy enumeration: " << listed << " paths, "
+              << timer.elapsed() << " seconds" << std::endl;
+
+    timer.reset();
+    size_t length = 0;
+    for (ices::path_count k = 0; k < counts.total(); ++k) {
+      length += ices::unrank_steps(counts, k).size();
+    }
+    std::cout << "unranking each path: " << counts.total() << " paths, "
+              << timer.elapsed() << " seconds" << std::endl;
+  }
+
+  print_bar();
+  std::cout << "uniform random path sampling" << std::endl;
+  for (ices::coordinate side : {100, 1000}) {
+    auto setting = ices::random_grid(side, side, side * side / 20, 3);
+    timer.reset();
+    ices::path_sampler sampler(setting);
+    double build_elapsed = timer.elapsed();
+    if (!sampler.any_path()) {
+      continue;
+    }
+    const size_t samples = 1000000 / side;
+    timer.reset();
+    auto paths = sampler.sample_batch(samples, 1);
+    double sample_elapsed = timer.elapsed();
+    std::cout << side << "x" << side << ": table " << build_elapsed << " seconds, "
+              << samples / sample_elapsed << " paths/second ("
+              << ices::default_pool().size() << " workers)" << std::endl;
+  }
+
+  print_bar();
+  std::cout << "path-through heat map, 5% icebergs" << std::endl;
+  for (ices::coordinate side : {1000, 4000}) {
+    auto setting = ices::random_grid(side, side, side * side / 20, 4);
+    timer.reset();
+    auto top = ices::top_path_through_cells(setting, 10);
+    double top_elapsed = timer.elapsed();
+    timer.reset();
+    ices::write_path_through_map(setting, "ices_timing_heat.bin");
+    double write_elapsed = timer.elapsed();
+    std::remove("ices_timing_heat.bin");
+    std::cout << side << "x" << side << ": top-10 " << top_elapsed << " seconds, "
+              << "full map to file " << write_elapsed << " seconds" << std::endl;
+  }
+
+  print_bar();
+  std::cout << "dynamic updates, 1% icebergs" << std::endl;
+  for (ices::coordinate width : {8, 32, 64}) {
+    const ices::coordinate height = 100000;
+    auto setting = ices::random_grid(height, width, height * width / 100, 5);
+    timer.reset();
+    ices::dynamic_path_counter counter(setting);
+    double build_elapsed = timer.elapsed();
+
+    std::mt19937 toggle_gen(width);
+    const int updates = 2000;
+    timer.reset();
+    unsigned checksum = 0;
+    for (int i = 0; i < updates; ++i) {
+      counter.toggle(1 + toggle_gen() % (height - 1), toggle_gen() % width);
+      checksum += counter.count();
+    }
+    double update_elapsed = timer.elapsed();
+
+    timer.reset();
+    std::vector<unsigned int> counts(width);
+    const int recomputes = 20;
+    for (int i = 0; i < recomputes; ++i) {
+      std::fill(counts.begin(), counts.end(), 0);
+      counts[0] = 1;
+      for (ices::coordinate r = 0; r < height; ++r) {
+        ices::advance_count_row(setting.row_words(r), counts.data(), width);
+      }
+      checksum += counts.back();
+    }
+    double recompute_elapsed = timer.elapsed();
+    std::cout << height << "x" << width << ": build " << build_elapsed << " seconds, "
+              << updates / update_elapsed << " updates/second, full recompute "
+              << recomputes / recompute_elapsed << "/second (checksum " << checksum << ")"
+              << std::endl;
+  }
+
+  print_bar();
+  std::cout << "what-if variants, 3 nearby changes each" << std::endl;
+  for (double density : {0.05, 0.3}) {
+    const ices::coordinate side = 2000;
+    auto base = ices::random_grid(side, side, ices::coordinate(side * side * density), 6);
+    timer.reset();
+    ices::variant_solver solver(base);
+    double build_elapsed = timer.elapsed();
+
+    std::mt19937 variant_gen(7);
+    std::vector<std::vector<ices::cell_change>> variants(400);
+    for (auto& changes : variants) {
+      ices::coordinate r = 1 + variant_gen() % (side - 3), c = variant_gen() % (side - 3);
+      for (int k = 0; k < 3; ++k) {
+        changes.push_back(ices::cell_change{r + k, c + k, ices::CELL_ICEBERG});
+      }
+    }
+    timer.reset();
+    auto counts = solver.count_all(variants);
+    double variant_elapsed = timer.elapsed();
+
+    timer.reset();
+    const size_t recomputes = 20;
+    unsigned mismatches = 0;
+    std::vector<unsigned int> row(side);
+    for (size_t i = 0; i < recomputes; ++i) {
+      ices::grid modified = base;
+      for (auto& change : variants[i]) {
+        modified.set(change.row, change.column, change.kind);
+      }
+      std::fill(row.begin(), row.end(), 0);
+      row[0] = 1;
+      for (ices::coordinate r = 0; r < side; ++r) {
+        ices::advance_count_row(modified.row_words(r), row.data(), side);
+      }
+      mismatches += (row.back() != counts[i]);
+    }
+    double recompute_elapsed = timer.elapsed();
+    std::cout << side << "x" << side << ", " << density * 100 << "% icebergs: base "
+              << build_elapsed << " seconds, " << variants.size() / variant_elapsed
+              << " variants/second vs full recompute " << recomputes / recompute_elapsed
+              << "/second (mismatches " << mismatches << ")" << std::endl;
+  }
+
+  print_bar();
+  std::cout << "reachability pruning, 4000x4000" << std::endl;
+  for (double density : {0.05, 0.2, 0.3, 0.35, 0.4, 0.5}) {
+    const ices::coordinate side = 4000;
+    auto setting = ices::random_grid_density(side, side, density, 10);
+    timer.reset();
+    std::vector<unsigned int> counts(side, 0);
+    counts[0] = 1;
+    for (ices::coordinate r = 0; r < side; ++r) {
+      ices::advance_count_row(setting.row_words(r), counts.data(), side);
+    }
+    double rolling_elapsed = timer.elapsed();
+    timer.reset();
+    auto pruned_output = ices::iceberg_avoiding_pruned(setting);
+    double pruned_elapsed = timer.elapsed();
+    std::cout << density * 100 << "% icebergs: rolling " << rolling_elapsed
+              << " seconds, pruned " << pruned_elapsed << " seconds"
+              << ((pruned_output == counts.back()) ? "" : " (MISMATCH)") << std::endl;
+  }
+
+  print_bar();
+  std::cout << "batch solving, 20000 grids" << std::endl;
+  for (ices::coordinate side : {8, 30, 60, 100}) {
+    std::vector<ices::grid> batch;
+    for (unsigned i = 0; i < 20000; ++i) {
+      ices::coordinate rows = side / 2 + i % (side / 2 + 1),
+                       columns = side / 2 + (i / 7) % (side / 2 + 1);
+      batch.push_back(ices::random_grid_density(rows, columns, 0.15, i));
+    }
+    timer.reset();
+    std::vector<unsigned int> looped;
+    for (auto& setting : batch) {
+      looped.push_back(iceberg_avoiding_dyn_prog(setting));
+    }
+    double loop_elapsed = timer.elapsed();
+    timer.reset();
+    auto batched = ices::iceberg_avoiding_batch(batch);
+    double batch_elapsed = timer.elapsed();
+    std::cout << "up to " << side << "x" << side << ": dyn_prog loop "
+              << batch.size() / loop_elapsed << " grids/second, batch "
+              << batch.size() / batch_elapsed << " grids/second"
+              << ((looped == batched) ? "" : " (MISMATCH)") << std::endl;
+  }
+
+  print_bar();
+  std::cout << "move sets, 5000x5000, 15% icebergs" << std::endl;
+  {
+    auto setting = ices::random_grid_density(5000, 5000, 0.15, 12);
+    auto report = [&](const char* name, auto&& solve) {
+      timer.reset();
+      unsigned output = solve();
+      std::cout << name << ": " << timer.elapsed() << " seconds (paths mod 2^32 = "
+                << output << ")" << std::endl;
+    };
+    report("right/down, advance_count_row", [&]() {
+      std::vector<unsigned int> counts(setting.columns(), 0);
+      counts[0] = 1;
+      for (ices::coordinate r = 0; r < setting.rows(); ++r) {
+        ices::advance_count_row(setting.row_words(r), counts.data(), setting.columns());
+      }
+      return counts.back();
+    });
+    report("right/down, count_move_paths",
+           [&]() { return ices::count_move_paths<ices::right_down_moves>(setting); });
+    report("right/down, generic kernel",
+           [&]() { return ices::count_move_paths<generic_right_down_moves>(setting); });
+    report("right/down, wavefront",
+           [&]() { return ices::iceberg_avoiding_wavefront(setting); });
+    report("diagonal, count_move_paths",
+           [&]() { return ices::count_move_paths<ices::diagonal_moves>(setting); });
+    report("knight, count_move_paths",
+           [&]() { return ices::count_move_paths<ices::knight_moves>(setting); });
+    report("knight, wavefront", [&]() {
+      return ices::count_move_paths_wavefront<ices::knight_moves>(setting, ices::all_moves());
+    });
+  }
+
+  print_bar();
+  std::cout << "minimum-cost paths, costs 1..100, 10% icebergs" << std::endl;
+  for (ices::coordinate side : {1000, 4000}) {
+    auto setting = ices::random_weighted_grid(side, side, 0.1, 100, 13);
+    timer.reset();
+    auto rolling = ices::min_path_cost(setting);
+    double rolling_elapsed = timer.elapsed();
+    timer.reset();
+    auto wavefront = ices::min_path_cost_wavefront(setting);
+    double wavefront_elapsed = timer.elapsed();
+    timer.reset();
+    auto cheapest = ices::min_cost_path(setting);
+    double path_elapsed = timer.elapsed();
+    std::cout << side << "x" << side << ": cost " << rolling << ", rolling "
+              << rolling_elapsed << " seconds, wavefront " << wavefront_elapsed
+              << " seconds, cheapest path " << path_elapsed << " seconds"
+              << ((wavefront == rolling && setting.cost_of(cheapest) == rolling) ? "" : " (MISMATCH)")
+              << std::endl;
+  }
+
+  print_bar();
+  std::cout << "paths crossing up to k icebergs, 4000x4000, 20% icebergs" << std::endl;
+  {
+    auto setting = ices::random_grid_density(4000, 4000, 0.2, 14);
+    for (ices::coordinate k : {0, 1, 3, 7, 15}) {
+      timer.reset();
+      auto rolling = ices::count_paths_crossing(setting, k);
+      double rolling_elapsed = timer.elapsed();
+      timer.reset();
+      auto wavefront = ices::count_paths_crossing_wavefront(setting, k);
+      double wavefront_elapsed = timer.elapsed();
+      std::cout << "k=" << k << ": rolling " << rolling_elapsed << " seconds, wavefront "
+                << wavefront_elapsed << " seconds" << ((rolling == wavefront) ? "" : " (MISMATCH)")
+                << std::endl;
+    }
+  }
+
+  print_bar();
+  std::cout << "row-major vs wavefront vs cache-oblivious, 10% icebergs" << std::endl;
+  for (auto shape : {std::make_pair(4000, 4000), std::make_pair(10000, 10000),
+                     std::make_pair(500, 4000000)}) {
+    auto setting = ices::random_grid_density(shape.first, shape.second, 0.1, 15);
+    timer.reset();
+    auto rolling = ices::iceberg_avoiding_rolling(setting);
+    double rolling_elapsed = timer.elapsed();
+    timer.reset();
+    auto wavefront = ices::iceberg_avoiding_wavefront(setting);
+    double wavefront_elapsed = timer.elapsed();
+    timer.reset();
+    auto oblivious = ices::iceberg_avoiding_oblivious(setting);
+    double oblivious_elapsed = timer.elapsed();
+    std::cout << shape.first << "x" << shape.second << ": row-major " << rolling_elapsed
+              << " seconds, wavefront " << wavefront_elapsed << " seconds, cache-oblivious "
+              << oblivious_elapsed << " seconds"
+              << ((rolling == wavefront && rolling == oblivious) ? "" : " (MISMATCH)")
+              << std::endl;
+  }
+
+  print_bar();
+  std::cout << "multi-process strips, 1000x2000000 binary grid file" << std::endl;
+  {
+    const std::string filename = "ices_timing_grid.bin";
+    std::mt19937_64 gen(16);
+    write_random_binary_grid(filename, 1000, 2000000, gen);
+    auto mapped = ices::load_grid(filename);
+    timer.reset();
+    auto expected = ices::iceberg_avoiding_rolling(mapped);
+    std::cout << "single process: " << timer.elapsed() << " seconds, count row "
+              << mapped.columns() * sizeof(unsigned int) << " bytes" << std::endl;
+    for (unsigned processes : {1, 2, 4, 8}) {
+      ices::strip_stats stats;
+      auto output = ices::iceberg_avoiding_strips(filename, processes, &stats);
+      std::cout << stats.processes << " processes: " << stats.seconds
+                << " seconds, count row per worker " << stats.worker_count_bytes << " bytes"
+                << ((output == expected) ? "" : " (MISMATCH)") << std::endl;
+    }
+    std::remove(filename.c_str());
+  }
+
+  print_bar();
+  std::cout << "solver planning: wide grids and sparse grids" << std::endl;
+  for (auto shape : {std::make_pair(64, 4000000), std::make_pair(500, 2000000)}) {
+    auto setting = ices::random_grid_density(shape.first, shape.second, 0.1, 17);
+    timer.reset();
+    auto rolling = ices::iceberg_avoiding_rolling(setting);
+    double rolling_elapsed = timer.elapsed();
+    timer.reset();
+    auto transposed = ices::transpose_grid(setting);
+    double transpose_elapsed = timer.elapsed();
+    timer.reset();
+    auto after = ices::iceberg_avoiding_rolling(transposed);
+    double after_elapsed = timer.elapsed();
+    std::cout << shape.first << "x" << shape.second << ": rolling " << rolling_elapsed
+              << " seconds, transpose " << transpose_elapsed << " + rolling "
+              << after_elapsed << " seconds" << ((rolling == after) ? "" : " (MISMATCH)")
+              << std::endl;
+    timer.reset();
+    auto planned = ices::iceberg_avoiding_planned(setting, true, ices::default_pool(), std::cout);
+    std::cout << "planned: " << timer.elapsed() << " seconds"
+              << ((rolling == planned) ? "" : " (MISMATCH)") << std::endl;
+  }
+  for (double density : {0.0001, 0.00001}) {
+    auto setting = ices::random_grid_density(5000, 5000, density, 18);
+    timer.reset();
+    auto rolling = ices::iceberg_avoiding_rolling(setting);
+    double rolling_elapsed = timer.elapsed();
+    timer.reset();
+    auto sparse = ices::iceberg_avoiding_sparse(setting);
+    std::cout << "5000x5000, " << ices::iceberg_count(setting) << " icebergs: rolling "
+              << rolling_elapsed << " seconds, sparse " << timer.elapsed() << " seconds"
+              << ((rolling == sparse) ? "" : " (MISMATCH)") << std::endl;
+  }
+
+  print_bar();
+  std::cout << "empty-band skipping, 100000x20000, 5% icebergs in a fraction of rows"
+            << std::endl;
+  for (double fraction : {1.0, 0.01, 0.001, 0.0001}) {
+    auto setting = ices::random_banded_grid(100000, 20000, 0.05, fraction, 19);
+    timer.reset();
+    auto rolling = ices::iceberg_avoiding_rolling(setting);
+    double rolling_elapsed = timer.elapsed();
+    ices::band_stats stats;
+    timer.reset();
+    auto bands = ices::iceberg_avoiding_bands(setting, ices::default_pool(), ices::BAND_AUTO,
+                                              &stats);
+    std::cout << "fraction " << fraction << ": rolling " << rolling_elapsed
+              << " seconds, bands " << timer.elapsed() << " seconds (" << stats.bands
+              << " bands, " << stats.ntt_bands << " by NTT, " << stats.rows_skipped
+              << " rows skipped)" << ((rolling == bands) ? "" : " (MISMATCH)") << std::endl;
+  }
+  for (ices::coordinate width : {1000, 20000, 1000000}) {
+    ices::binomial_table binomial(2 * width);
+    auto kernel = ices::band_kernel(binomial, width, width);
+    std::vector<unsigned int> counts(width, 1);
+    timer.reset();
+    ices::convolve_ntt(counts.data(), kernel.data(), width);
+    double ntt_elapsed = timer.elapsed();
+    std::cout << "one band, " << width << " columns: NTT " << ntt_elapsed << " seconds";
+    if (width <= 20000) {
+      timer.reset();
+      ices::convolve_direct(counts.data(), kernel.data(), width);
+      std::cout << ", direct " << timer.elapsed() << " seconds";
+    }
+    std::cout << std::endl;
+  }
+
+  print_bar();
+  std::cout << "path-count queries, 4000x4000, 10% icebergs" << std::endl;
+  {
+    auto setting = ices::random_grid_density(4000, 4000, 0.1, 20);
+    std::mt19937 gen(20);
+    auto cell = [&](ices::coordinate low, ices::coordinate high) {
+      return low + ices::coordinate(gen() % (high - low));
+    };
+    // Every pair of 30 sources in the top half and 30 targets in the bottom
+    // half, and 100 queries with nothing in common.
+    std::vector<ices::path_query> queries, targets;
+    for (int j = 0; j < 30; ++j) {
+      targets.push_back({0, 0, cell(2000, 4000), cell(2000, 4000)});
+    }
+    for (int i = 0; i < 30; ++i) {
+      ices::coordinate r = cell(0, 2000), c = cell(0, 2000);
+      for (const auto& target : targets) {
+        queries.push_back({r, c, target.to_row, target.to_column});
+      }
+    }
+    for (int i = 0; i < 100; ++i) {
+      queries.push_back({cell(0, 2000), cell(0, 2000), cell(2000, 4000), cell(2000, 4000)});
+    }
+    // Both approaches on one worker, to isolate the saving from shared
+    // endpoints, and on every worker.
+    ices::work_stealing_pool one(1);
+    for (auto* pool : {&one, &ices::default_pool()}) {
+      timer.reset();
+      auto answers = ices::count_paths_between(setting, queries, *pool);
+      double batch_elapsed = timer.elapsed();
+      timer.reset();
+      std::vector<unsigned int> single(queries.size());
+      pool->parallel_for(queries.size(), [&](size_t i, unsigned) {
+        single[i] = ices::count_paths_between(setting, queries[i]);
+      });
+      std::cout << queries.size() << " queries, " << pool->size()
+                << " workers: divide and conquer " << batch_elapsed
+                << " seconds, one DP per query " << timer.elapsed() << " seconds"
+                << ((answers == single) ? "" : " (MISMATCH)") << std::endl;
+    }
+  }
+
+  print_bar();
+  std::cout << "packed paths vs ices::path, sampled paths" << std::endl;
+  for (auto shape : {std::make_pair(60, 60), std::make_pair(1000, 1000)}) {
+    auto setting = ices::random_grid_density(shape.first, shape.second, 0.05, 23);
+    ices::path_sampler sampler(setting);
+    const size_t count = (shape.first < 100) ? 200000 : 20000;
+    const auto steps = setting.rows() + setting.columns() - 2;
+    const auto words = ices::words_per_path(setting);
+    auto batch = sampler.sample_batch(count, 23);
+
+    timer.reset();
+    std::vector<ices::path> paths;
+    paths.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      paths.push_back(ices::unpack_path(setting, &batch[i * words]));
+    }
+    double path_build = timer.elapsed();
+    timer.reset();
+    size_t path_equal = 0;
+    for (size_t i = 1; i < count; ++i) {
+      path_equal += (paths[i] == paths[i - 1]);
+    }
+    double path_compare = timer.elapsed();
+
+    timer.reset();
+    std::vector<ices::packed_path> packed;
+    packed.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      packed.emplace_back(setting, &batch[i * words], steps);
+    }
+    double packed_build = timer.elapsed();
+    timer.reset();
+    size_t packed_equal = 0;
+    for (size_t i = 1; i < count; ++i) {
+      packed_equal += (packed[i] == packed[i - 1]);
+    }
+    double packed_compare = timer.elapsed();
+
+    size_t path_bytes = sizeof(ices::path) + paths[0].steps().capacity() * sizeof(ices::step),
+           packed_bytes = sizeof(ices::packed_path) +
+                          ((words > ices::PACKED_PATH_INLINE_WORDS) ? words * 8 : 0);
+    std::cout << shape.first << "x" << shape.second << ", " << count << " paths of "
+              << steps << " steps: path " << path_bytes << " bytes each, built in "
+              << path_build << " seconds, compared in " << path_compare
+              << " seconds; packed_path " << packed_bytes << " bytes each, built in "
+              << packed_build << " seconds, compared in " << packed_compare << " seconds"
+              << ((path_equal == packed_equal) ? "" : " (MISMATCH)") << std::endl;
+  }
+
+  print_bar();
+  std::cout << "fixed-size grids, 100000 random 8x8 grids" << std::endl;
+  {
+    std::vector<ices::grid> grids;
+    std::vector<ices::fixed_grid<8, 8>> fixed;
+    for (std::uint64_t seed = 0; seed < 100000; ++seed) {
+      grids.push_back(ices::random_grid_density(8, 8, 0.2, seed));
+      fixed.emplace_back(grids.back());
+    }
+    timer.reset();
+    unsigned int rolling = 0;
+    for (const auto& setting : grids) {
+      rolling += ices::iceberg_avoiding_rolling(setting);
+    }
+    double rolling_elapsed = timer.elapsed();
+    timer.reset();
+    unsigned int compiled = 0;
+    for (const auto& setting : fixed) {
+      compiled += ices::iceberg_avoiding_fixed(setting);
+    }
+    std::cout << "rolling DP " << rolling_elapsed << " seconds, fixed-size DP "
+              << timer.elapsed() << " seconds" << ((rolling == compiled) ? "" : " (MISMATCH)")
+              << std::endl;
+  }
+
+  print_bar();
+  {
+    // 250 MB on disk, and a gigabyte resident across four private copies,
+    // only with --large-files.
+    const ices::coordinate rows = large_files ? 20000 : 4000;
+    std::cout << "shared read-only grids, " << rows << "x100000 binary grid file" << std::endl;
+    const std::string filename = "ices_timing_grid.bin";
+    std::mt19937_64 gen(24);
+    write_random_binary_grid(filename, rows, 100000, gen);
+    for (unsigned processes : {1, 4}) {
+      for (bool shared : {false, true}) {
+        time_shared_grids(filename, processes, shared);
+      }
+    }
+    std::remove(filename.c_str());
+  }
+
+  print_bar();
+  std::cout << "exact counts, 10% icebergs: CRT lanes vs big-integer DP" << std::endl;
+  for (ices::coordinate side : {1000, 2000, 4000}) {
+    auto setting = ices::random_grid_density(side, side, 0.1, 26);
+    timer.reset();
+    auto exact = ices::iceberg_avoiding_exact(setting);
+    double exact_elapsed = timer.elapsed();
+    timer.reset();
+    auto bigint = ices::iceberg_avoiding_bigint(setting);
+    std::cout << side << "x" << side << ", " << exact.to_string().size() << " digits, "
+              << ices::crt_prime_count(side, side) << " primes: CRT " << exact_elapsed
+              << " seconds, big-integer DP " << timer.elapsed() << " seconds"
+              << ((exact == bigint) ? "" : " (MISMATCH)") << std::endl;
+  }
+
+  print_bar();
+  std::cout << "disjoint convoys, 5% icebergs: LGV determinant mod p vs exact (Bareiss)"
+            << std::endl;
+  {
+    // The exhaustive oracle, on a grid small enough for it.
+    auto setting = ices::grid(7, 7);
+    std::vector<ices::grid_cell> sources = {{0, 0}, {0, 1}, {0, 2}},
+                                 sinks = {{6, 4}, {6, 5}, {6, 6}};
+    timer.reset();
+    long long oracle = ices::count_disjoint_paths_exhaustive(setting, sources, sinks);
+    double oracle_elapsed = timer.elapsed();
+    timer.reset();
+    auto exact = ices::count_disjoint_paths_exact(setting, sources, sinks);
+    std::cout << "7x7, k=3: exhaustive " << oracle_elapsed << " seconds, LGV "
+              << timer.elapsed() << " seconds"
+              << ((exact == ices::big_integer(oracle)) ? "" : " (MISMATCH)") << std::endl;
+  }
+  for (ices::coordinate side : {500, 1000, 2000}) {
+    auto setting = ices::random_grid_density(side, side, 0.05, 27);
+    for (size_t k : {2, 4, 8, 16}) {
+      // Ships spread along the top row, bound for the bottom row, each
+      // endpoint cleared of ice.
+      const ices::coordinate stride = side / (2 * k);
+      std::vector<ices::grid_cell> sources, sinks;
+      for (size_t i = 0; i < k; ++i) {
+        sources.push_back({0, i * stride});
+        sinks.push_back({side - 1, side - 1 - (k - 1 - i) * stride});
+        setting.set(sources[i].row, sources[i].column, ices::CELL_WATER);
+        setting.set(sinks[i].row, sinks[i].column, ices::CELL_WATER);
+      }
+      timer.reset();
+      auto modular = ices::count_disjoint_paths_mod(setting, sources, sinks);
+      double modular_elapsed = timer.elapsed();
+      timer.reset();
+      auto counts = ices::lgv_matrix_exact(setting, sources, sinks);
+      double matrix_elapsed = timer.elapsed();
+      timer.reset();
+      auto exact = ices::determinant_bareiss(
+          std::vector<ices::big_integer>(counts.begin(), counts.end()), k);
+      std::cout << side << "x" << side << ", k=" << k << ": mod p " << modular_elapsed
+                << " seconds, exact matrix " << matrix_elapsed << " + Bareiss "
+                << timer.elapsed() << " seconds, " << exact.to_string().size() << " digits"
+                << ((exact.residue(ices::LGV_PRIME) == modular) ? "" : " (MISMATCH)")
+                << std::endl;
+    }
+  }
+
+  print_bar();
+  std::cout << "random grid generation, 1% icebergs" << std::endl;
+  for (ices::coordinate side : {1000, 3000, 100000}) {
+    unsigned icebergs = side * side / 100;
+    if (side <= 3000) {
+      std::mt19937 shuffle_gen;
+      timer.reset();
+      auto shuffled = ices::grid::random(side, side, icebergs, shuffle_gen);
+      std::cout << side << "x" << side << " grid::random: "
+                << timer.elapsed() << " seconds" << std::endl;
+    }
+    timer.reset();
+    auto sampled = ices::random_grid(side, side, icebergs, 1);
+    std::cout << side << "x" << side << " random_grid: "
+              << timer.elapsed() << " seconds" << std::endl;
+  }
+
   print_bar();
 
   return 0;
 }
+
+int main(int argc, char* argv[]) {
+
+  if (argc == 1) {
+    return run_report(false);
+  }
+  if (argc == 2 && std::string(argv[1]) == "--large-files") {
+    return run_report(true);
+  }
+  sweep_options options;
+  if (std::string(argv[1]) != "sweep") {
+    print_sweep_usage(std::cerr, sweep_solvers(options.exhaustive_max));
+    return 2;
+  }
+  try {
+    if (!parse_sweep_options(argc, argv, options)) {
+      print_sweep_usage(std::cout, sweep_solvers(options.exhaustive_max));
+      return 0;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << argv[0] << ": " << e.what() << std::endl;
+    print_sweep_usage(std::cerr, sweep_solvers(options.exhaustive_max));
+    return 2;
+  }
+
+  try {
+    size_t mismatches;
+    if (options.csv.empty()) {
+      mismatches = run_sweep(options, std::cout);
+    } else {
+      std::ofstream csv(options.csv);
+      if (!csv) {
+        throw std::runtime_error("cannot open " + options.csv);
+      }
+      mismatches = run_sweep(options, csv);
+    }
+    return (mismatches == 0) ? 0 : 1;
+  } catch (const std::exception& e) {
+    std::cerr << argv[0] << ": " << e.what() << std::endl;
+    return 1;
+  }
+}
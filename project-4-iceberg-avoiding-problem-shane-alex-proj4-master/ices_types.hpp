@@ -11,7 +11,9 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <random>
 #include <string>
 #include <vector>
@@ -26,25 +28,85 @@ using coordinate = size_t;
 // Type for one element of the map grid.
 enum cell_kind { CELL_WATER, CELL_ICEBERG};
 
+// Bit-packed rows store one cell per bit, 64 cells per word, with bit
+// (column % 64) of word (column / 64) set when that cell is CELL_ICEBERG.
+// Bits past the last column are always 0.
+using grid_word = std::uint64_t;
+const coordinate GRID_WORD_BITS = 64;
+
+// Number of words needed to hold a bit-packed row of the given width.
+constexpr coordinate words_per_row(coordinate columns) {
+  return (columns + GRID_WORD_BITS - 1) / GRID_WORD_BITS;
+}
+
 // Type for a rectangular grid representing the map.
+//
+// Cells are stored as bit-packed rows (see grid_word), stride() words apart.
+// A grid normally owns its rows, but it may instead be a read-only view of
+// rows held elsewhere, such as a memory-mapped file; see grid::view.
 class grid {
 private:
-  std::vector<std::vector<cell_kind>> cells_;
+  coordinate rows_, columns_, stride_;
+  std::vector<grid_word> words_;
+
+  // For a view, the first word of the viewed rows and whatever keeps them
+  // alive; otherwise nullptr.
+  const grid_word* view_;
+  std::shared_ptr<const void> view_owner_;
+
+  const grid_word* data() const { return view_ ? view_ : words_.data(); }
 
 public:
 
   // Create a grid with the given number of rows and columns, all initialized
   // to hold CELL_WATER.
   grid(coordinate rows, coordinate columns)
-  : cells_(rows, std::vector<cell_kind>(columns, CELL_WATER)) {
+  : rows_(rows), columns_(columns), stride_(words_per_row(columns)),
+    words_(rows * stride_, 0), view_(nullptr) {
 
     assert(rows > 0);
     assert(columns > 0);
   }
 
+  // Create a grid that takes ownership of rows * words_per_row(columns)
+  // bit-packed words.
+  grid(coordinate rows, coordinate columns, std::vector<grid_word>&& words)
+  : rows_(rows), columns_(columns), stride_(words_per_row(columns)),
+    words_(std::move(words)), view_(nullptr) {
+
+    assert(rows > 0);
+    assert(columns > 0);
+    assert(words_.size() == rows * stride_);
+  }
+
+  // Create a read-only grid over bit-packed rows that it does not own.
+  // Row r starts at words + r * stride. owner is held for as long as any
+  // copy of the view exists, and may be null if the caller keeps the
+  // words alive itself.
+  static grid view(coordinate rows, coordinate columns, coordinate stride,
+                   const grid_word* words, std::shared_ptr<const void> owner) {
+    assert(stride >= words_per_row(columns));
+    grid result(1, 1);
+    result.rows_ = rows;
+    result.columns_ = columns;
+    result.stride_ = stride;
+    result.words_.clear();
+    result.view_ = words;
+    result.view_owner_ = std::move(owner);
+    return result;
+  }
+
   // Accessors.
-   coordinate rows() const { return cells_.size(); }
-   coordinate columns() const { return cells_.front().size(); }
+   coordinate rows() const { return rows_; }
+   coordinate columns() const { return columns_; }
+   coordinate stride() const { return stride_; }
+   bool is_view() const { return view_ != nullptr; }
+
+  // Return the bit-packed words of the given row.
+   const grid_word* row_words(coordinate row) const {
+    assert(is_row(row));
+    return data() + row * stride_;
+  }
 
   // Test whether the given value is a valid row or column number.
    bool is_row(coordinate row) const { return row < rows(); }
@@ -56,19 +118,28 @@ public:
   // Return the cell at the given row and column.
    cell_kind get(coordinate row, coordinate column) const {
     assert(is_row_column(row, column));
-    return cells_[row][column];
+    grid_word word = data()[row * stride_ + column / GRID_WORD_BITS];
+    return ((word >> (column % GRID_WORD_BITS)) & 1) ? CELL_ICEBERG : CELL_WATER;
   }
 
   // Set the contents of the cell at the given row and column.
   // (0, 0) may only be CELL_WATER. Other coordinates may be any kind.
+  // Views are read-only.
    void set(coordinate row, coordinate column, cell_kind kind) {
     assert(is_row_column(row, column));
+    assert(!is_view());
 
     if ((row == 0) && (column == 0)) {
       assert(kind == CELL_WATER);
     }
 
-    cells_[row][column] = kind;
+    grid_word& word = words_[row * stride_ + column / GRID_WORD_BITS];
+    grid_word bit = grid_word(1) << (column % GRID_WORD_BITS);
+    if (kind == CELL_ICEBERG) {
+      word |= bit;
+    } else {
+      word &= ~bit;
+    }
   }
 
   // Return true if it is valid to step into the given row and column.
@@ -76,7 +147,7 @@ public:
   // that cell is not CELL_ICEBERG.
    bool may_step(coordinate row, coordinate column) const {
     return (is_row_column(row, column) &&
-            (cells_[row][column] != CELL_ICEBERG));
+            (get(row, column) != CELL_ICEBERG));
   }
 
   // Return strings corresponding to lines of text in a human-readable